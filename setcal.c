@@ -1,19 +1,88 @@
+#define _POSIX_C_SOURCE 200809L // for mmap, fstat, read and other POSIX functions
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+// SIMD kernels for bitsets are selected at runtime (compile with -DSETCAL_NO_SIMD to use only scalar ones)
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(SETCAL_NO_SIMD)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
 
 // constants for reserved words or symbols
-#define MODE "r"
+#define STDIN "-"               // file name for reading from standard input
+#define READ_CHUNK (1 << 20)    // size of chunk for reading pipes and standard input
+#define OUTPUT_BUFFER (1 << 20) // size of buffer for standard output
+#define OUTPUT_DIRECT (1 << 12) // longer lines are written straight from input (without copying into buffer)
+#define STREAM_OPTION "--stream" // option for executing commands while the input is being read
+#define JOBS_OPTION "--jobs"     // option for executing commands by more threads (--jobs N)
+#define CACHE_STATS_OPTION "--cache-stats" // option for printing hit rate of cache of commands (to standard error output)
+#define STATS_OPTION "--stats"   // option for printing times of phases, latencies of commands and used memory (to standard error output)
+#define STATS_JSON_OPTION "--stats-json" // option for writing the same statistics as JSON into file (--stats-json FILE)
+#define SERVE_OPTION "--serve"   // option for loading definitions once and answering commands sent over socket (--serve SOCKET)
+#define CLIENT_OPTION "--client" // option for sending commands to server (--client SOCKET)
+#define SAVE_SNAPSHOT_OPTION "--save-snapshot" // option for saving parsed definitions into binary file (--save-snapshot FILE)
+#define LOAD_SNAPSHOT_OPTION "--load-snapshot" // option for executing commands on definitions from binary file (--load-snapshot FILE)
+#define GEN_OPTION "--gen"       // option for writing random input to standard output (--gen universe=1000,shape=chain,...)
+#define BENCH_OPTION "--bench"   // option for timing every command N times (--bench N), times of command classes are printed as CSV
+#define BENCH_JSON_OPTION "--bench-json" // times of --bench are printed as JSON
+#define BENCH_WARMUP 1           // runs of every command before the measured ones
+#define WATCH_OPTION "--watch"   // option for executing file again whenever it is changed (only commands affected by the change)
+#define WATCH_POLL 200           // milliseconds between checks of time of change of watched file (without inotify)
+#define NULL_DEVICE "/dev/null"  // output of commands is thrown away by benchmark
+#define SNAPSHOT_MAGIC "SETCALSN" // the first bytes of snapshot
+#define SNAPSHOT_VERSION 2        // version of format of snapshot (new layout of parsed definitions or new HashString needs new version)
+#define CACHE_SLOTS 64                     // size of the first hash table of cache
+#define CACHE_MAX_BYTES (64 << 20)         // outputs of commands aren't cached over this size
+#define MAX_JOBS 1024            // maximal count of threads
+#define RESULT_BUFFER 256        // size of the first buffer for result of command (it grows if needed)
+#define RESULT_BLOCK 256         // size of the first block of memory for kept result of command
+#define PARSE_CHUNK 64           // count of definitions parsed by thread at once
+#define COMMAND_COUNT 29         // count of descriptors in COMMANDS (restricted words included)
+#define HISTOGRAM_BUCKETS 40     // bucket i of latency histogram counts commands which took [2^i, 2^(i+1)) ns (the last one counts longer ones too)
 #define SET 'S'
 #define RELATION 'R'
 #define UNIVERSUM 'U'
 #define COMMAND 'C'
-#define MAX_LENGTH 30
+#define EXPRESSION 'E' // kind of argument of command which is set expression (like "(1 | 2) & ~3 - 4")
+#define OPERAND '#'    // instruction of compiled expression which pushes the next operand
 #define PAIR 2
-#define MAX_LINES 1000
-#define SPACE " "
-#define REL_SPACE "()"
+#define MAX_ARGUMENTS 3           // commands have at most 3 arguments
+#define MAX_OPERANDS 256          // set expression has at most 256 operands
+#define EVAL_BLOCK 8              // count of words evaluated at once by compiled expression
+#define ARENA_BLOCK (64 << 10)    // size of the first block of arena (next blocks are bigger)
+#define ARENA_MAX_BLOCK (64 << 20) // blocks of arena don't grow over this size
+#define NOT_FOUND UINT32_MAX // ID returned for elements which are not in universum
+#define WORD_BITS 64          // bits in one word of bitset
+#define MATRIX_MAX_BYTES (64 << 20) // bigger relations are checked on sorted pairs instead of bit matrix
+#define SEEN_FIRST 1  // flag of element which is the first one in some pair
+#define SEEN_SECOND 2 // flag of element which is the second one in some pair
+#define CHUNK_BITS 16 // IDs of set are split into chunks of 2^16 IDs by their upper bits, every chunk with some element has its own container
+#define CHUNK_WORDS ((1 << CHUNK_BITS) / WORD_BITS) // count of words in bitmap container (8KB)
+#define ARRAY_MAX 4096 // array containers have at most 4096 values (bigger array wouldn't be smaller than bitmap)
+#define GALLOP_RATIO 32 // values of smaller array are searched in bigger one by galloping (exponential search) if it is 32 times bigger
+#define ARRAY_CONTAINER 'A'  // container with sorted array of 16-bit values
+#define BITMAP_CONTAINER 'B' // container with bitmap of the whole chunk
+#define RUN_CONTAINER 'N'    // container with runs of consecutive values (16-bit start and length - 1 of every run)
 // constants for set commands
 #define EMPTY "empty"
 #define CARD "card"
@@ -24,6 +93,7 @@
 #define SUBSETEQ "subseteq"
 #define SUBSET "subset"
 #define EQUALS "equals"
+#define EVAL "eval"
 // constants for relation commands
 #define REFLEXIVE "reflexive"
 #define SYMMETRIC "symmetric"
@@ -35,6 +105,13 @@
 #define INJECTIVE "injective"
 #define SURJECTIVE "surjective"
 #define BIJECTIVE "bijective"
+#define CLOSURE_TRANS "closure_trans"
+#define CLOSURE_REFL "closure_refl"
+#define CLOSURE_SYM "closure_sym"
+#define CLOSURE_EQUIV "closure_equiv"
+#define COMPOSE "compose"
+#define INVERSE "inverse"
+#define RESTRICT "restrict"
 
 #define _TRUE "true"
 #define _FALSE "false"
@@ -43,47 +120,17 @@
 #define reset(var) var = 0;                                             // reset macro (basically takes a variable and assigns 0 to it)
 #define allocate(var, size) ((var = malloc(size)) == NULL)              // macro for allocating memory and checking if memory was allocated
 #define reallocate(err, var, size) ((err = realloc(var, size)) == NULL) // macro for reallocating memory and checking if memory was reallocated
+#define BitsetWords(count) (((count) + WORD_BITS - 1) / WORD_BITS) // count of words needed for bitset of count elements
+#define Align8(size) (((size) + 7) & ~(uint64_t)7) // size rounded up to multiple of 8 (sections of snapshot are aligned)
+#define ElementName(universum, id) ((universum)->pool + (universum)->names[id]) // name of element with ID
+#define ChunkWords(words) (((words) + CHUNK_WORDS - 1) / CHUNK_WORDS * CHUNK_WORDS) // words of bitset rounded up to whole chunks
+#define ContainerWords(type, size) ((type) == BITMAP_CONTAINER ? CHUNK_WORDS : (type) == ARRAY_CONTAINER ? ((size) + 3) / 4 : ((size) + 1) / 2) // words of data of container
+#define BitsetHas(bits, id) ((bits)[(id) / WORD_BITS] >> ((id) % WORD_BITS) & 1) // checks if element with ID is in bitset
 #define isValidChar(ch) ((str[i] >= 'A' && str[i] <= 'Z') || (str[i] >= 'a' && str[i] <= 'z') || str[i] == ' ')
 
-// macro to clean up set structures
-#define FreeSet(set)                     \
-    for (int i = 0; i < set->count; i++) \
-        free(set->elements[i]);          \
-    free(set->elements);                 \
-    free(set);
-
-#define FreeRelation(rel) \
-    free(rel->pair);      \
-    free(rel);
-
 // custom types
 typedef char *string; // custom string (char *)
 
-#define RESTRICTED_COUNT 21
-
-const string RESTRICTED[RESTRICTED_COUNT] = {
-    EMPTY,
-    CARD,
-    COMPLEMENT,
-    UNION,
-    INTERSECT,
-    MINUS,
-    SUBSETEQ,
-    SUBSET,
-    EQUALS,
-    _TRUE,
-    _FALSE,
-    REFLEXIVE,
-    SYMMETRIC,
-    ANTISYMMETRIC,
-    TRANSITIVE,
-    FUNCTION,
-    DOMAIN,
-    CODOMAIN,
-    INJECTIVE,
-    SURJECTIVE,
-    BIJECTIVE,
-};
 enum ERROR_CODES
 {
     MEMORY_ERR = 1,
@@ -97,31 +144,337 @@ enum ERROR_CODES
     SET_SYNTAX_ERR,
     COMMAND_SYNTAX_ERR,
     ELEM_NOT_DEFINED,
-    LINE_LIMIT_ERR
-
 };
-typedef struct // struct for sets
+enum PHASES // phases of run measured by --stats
 {
-    string *elements;
-    int count;
+    LOAD_PHASE,        // reading or mapping input (and snapshot)
+    UNIVERSUM_PHASE,   // validating and interning universum
+    DEFINITIONS_PHASE, // parsing sets and relations
+    COMMANDS_PHASE,    // executing commands
+    OUTPUT_PHASE,      // writing the rest of output and releasing memory
+    WAIT_PHASE,        // server waits for clients (or --watch waits for change of file)
+    PHASE_COUNT,
+};
+typedef struct // container of IDs of set with the same upper bits (roaring-style, containers don't have pointers, so they can be mapped from snapshot)
+{
+    uint32_t key;    // upper bits of IDs in container (ID >> CHUNK_BITS)
+    uint32_t count;  // count of IDs in container
+    uint32_t size;   // count of values of array or count of runs (bitmap has CHUNK_WORDS words)
+    uint32_t type;   // ARRAY_CONTAINER, BITMAP_CONTAINER or RUN_CONTAINER
+    uint64_t offset; // index of the first word of container in data of set
+} container_t;
+typedef struct // struct for sets (only chunks with some elements have containers, they are sorted by keys)
+{
+    container_t *containers;
+    uint32_t size;  // count of containers
+    int count;      // count of elements
+    uint64_t *data; // words of all the containers one after another
 } set_t;
+typedef struct // struct for universum (symbol table of interned elements)
+{
+    uint64_t *names;   // offsets of names of elements in pool (indexed by ID), so symbol table can be mapped from snapshot
+    char *pool;        // names of all the elements one after another (each name is stored only once)
+    uint32_t *lengths; // lengths of names (indexed by ID)
+    uint32_t count;    // count of elements
+    uint32_t *slots; // open addressing hash table (0 - empty slot, otherwise ID + 1)
+    uint32_t mask;   // size of hash table - 1 (size is a power of 2)
+    set_t *set;      // all the elements of universum as set (needed for complement)
+    size_t words;    // count of words in bitsets of this universum
+} symtab_t;
 typedef struct // struct for pairs in relation
 {
-    char elements[PAIR][MAX_LENGTH];
+    uint32_t elements[PAIR]; // IDs of elements
 } pair_t;
 typedef struct // struct for relations
 {
     pair_t *pair;
     int count;
 } rel_t;
+typedef struct // struct for relation as bit matrix (only elements which are in relation have rows and columns)
+{
+    uint32_t size;   // count of rows (multiple of WORD_BITS, so matrix can be split into 64x64 blocks)
+    size_t words;    // words in one row
+    uint32_t *index; // index of row and column of element (indexed by ID, NOT_FOUND if element isn't in relation)
+    uint32_t *ids;   // ID of element of row (indexes are given in the order of IDs)
+    uint32_t count;  // count of elements in relation
+    uint64_t *rows;  // bit j of row i is set if pair (element i, element j) is in relation
+} matrix_t;
+typedef struct // struct for relation as compressed sparse rows (row of every element of universum, sorted by IDs)
+{
+    uint32_t *offsets; // row of element a is targets[offsets[a]] .. targets[offsets[a + 1] - 1]
+    uint32_t *targets; // the second elements of pairs
+} csr_t;
+typedef struct // properties of relation as mapping (found by one pass over pairs)
+{
+    bool fromSets;   // all the first elements are from set1 and all the second elements are from set2
+    bool function;   // no element is the first one in more than one pair
+    bool injective;  // no element is the second one in more than one pair
+    int images;      // count of different second elements
+} mapping_t;
+typedef struct block // struct for block of memory in arena
+{
+    struct block *next; // next block in arena
+    size_t size;        // size of data
+    size_t used;        // used bytes of data
+    char data[];        // memory for allocations
+} block_t;
+typedef struct // struct for arena (region) allocator, all the allocations are released at once
+{
+    block_t *first;   // the first block
+    block_t *current; // block used for allocations
+    size_t blockSize; // size of the next block
+    size_t allocated; // bytes allocated from the system
+} arena_t;
+typedef struct // struct for position in arena (allocations after it can be released)
+{
+    block_t *block; // block used for allocations (NULL if nothing was allocated)
+    size_t used;    // used bytes of the block
+} mark_t;
+typedef struct // struct for set built container by container (buffers are in arena and they grow twice when they are full)
+{
+    set_t set;         // containers and data are in buffers
+    uint32_t capacity; // size of buffer of containers
+    size_t used;       // count of used words of data
+    size_t words;      // size of buffer of data
+    arena_t *arena;    // memory for buffers (usually scratch memory of command)
+} builder_t;
+typedef struct // struct for parsed definition (line with universum, set or relation) or for kept result of command
+{
+    set_t *set;     // parsed set or universum (NULL if line isn't set)
+    rel_t *rel;     // parsed relation (NULL if line isn't relation)
+    arena_t arena;  // own memory of definition (only if it can be released before the end of run)
+    string source;  // command whose result isn't kept (--stream of pipe executes it again when some command refers to it)
+} def_t;
+typedef struct // struct for buffered output (written by write when buffer is full)
+{
+    int fd;       // file descriptor of output (-1 if output is kept in memory, buffer grows then)
+    char *data;   // buffer
+    size_t size;  // used bytes of buffer
+    size_t capacity;
+    bool lost;    // true if buffer couldn't grow (some output is lost)
+    int flushes;  // count of writes of buffer (output of command is whole in buffer if it didn't change)
+    size_t written; // bytes written to fd
+} output_t;
+typedef struct // struct for counters of commands executed by one thread (merged into statistics when thread ends)
+{
+    uint64_t count[COMMAND_COUNT];       // executed commands of every kind (indexed like COMMANDS)
+    uint64_t nanoseconds[COMMAND_COUNT]; // total time of them
+    uint64_t histogram[COMMAND_COUNT][HISTOGRAM_BUCKETS]; // latencies of them
+} counters_t;
+typedef struct // struct for context of command execution
+{
+    symtab_t *universum; // interned universum
+    arena_t *scratch;    // memory for temporaries of command (released after each command)
+    output_t *out;       // where results of commands are written
+    def_t *result;       // where set or relation which is result of command is kept (NULL if no next command refers to it)
+    counters_t *counters; // counters of this thread (NULL if statistics aren't collected)
+} context_t;
+typedef struct // struct for queue of commands of one thread (owner takes them from head, other threads steal them from tail)
+{
+    int *tasks; // indexes of lines with commands
+    int head;
+    int tail;
+    pthread_mutex_t lock;
+} queue_t;
+typedef struct // struct for commands executed by more threads (definitions are only read by them)
+{
+    string *lines;        // all the lines
+    int lineCount;        // count of all the lines
+    int begin;            // index of the first line with command
+    int end;              // index of the line after the last command
+    def_t *defs;          // parsed definitions and kept results of commands
+    int *firstUse;        // the first command referring to every line (results of commands which are referred to are kept)
+    symtab_t *universum;  // interned universum
+    int jobs;             // count of threads
+    queue_t *queues;      // queue of every thread
+    output_t *results;    // output of every command (indexed by line - begin)
+    int *errors;          // error code of every command (-1 if command isn't finished yet)
+    int next;             // next line which output is written
+    output_t *out;        // output for results in the right order
+    int errorCode;        // error code of the first command which failed
+    bool stop;            // true if some command failed (next commands don't have to be executed)
+    pthread_mutex_t lock; // lock for writing output
+} pool_t;
+typedef struct // struct for definitions parsed by more threads
+{
+    string *lines;        // all the lines
+    int end;              // index of the first line with command (definitions are before it)
+    symtab_t *universum;  // interned universum
+    def_t *defs;          // parsed definitions
+    int next;             // the first line of the next chunk
+    int failed;           // the first line which can't be parsed (end if there is none)
+    pthread_mutex_t lock; // lock for next and failed
+} parser_t;
+typedef struct // struct for thread which parses definitions
+{
+    parser_t *parser;
+    arena_t arena; // memory for definitions parsed by this thread (released at the end of run)
+    pthread_t thread;
+} parsing_t;
+typedef struct // struct for thread of pool
+{
+    pool_t *pool;
+    int id;       // index of its queue
+    pthread_t thread;
+} worker_t;
+typedef struct // struct for bitset and array kernels (selected at runtime by CPU features)
+{
+    void (*or)(uint64_t *dest, const uint64_t *a, const uint64_t *b, size_t words);     // dest = a | b
+    void (*and)(uint64_t *dest, const uint64_t *a, const uint64_t *b, size_t words);    // dest = a & b
+    void (*andnot)(uint64_t *dest, const uint64_t *a, const uint64_t *b, size_t words); // dest = a & ~b
+    size_t (*popcount)(const uint64_t *a, size_t words);                                 // count of bits in a
+    bool (*zero)(const uint64_t *a, size_t words);                                       // a == 0
+    bool (*subseteq)(const uint64_t *a, const uint64_t *b, size_t words);                // (a & ~b) == 0
+    bool (*equal)(const uint64_t *a, const uint64_t *b, size_t words);                   // a == b
+    uint32_t (*intersect)(const uint16_t *a, uint32_t m, const uint16_t *b, uint32_t n, uint16_t *dest); // sorted values which are in both arrays, returns their count
+} kernels_t;
+typedef struct // struct for input loaded in memory
+{
+    char *data;    // content of input (ends of lines are replaced by '\0')
+    size_t size;   // size of content
+    bool mapped;   // true if data is mapped file, false if it was read in buffer
+    string *lines; // lines (views into data, nothing is copied)
+    int count;     // count of lines
+} input_t;
+typedef struct // struct for reading input line by line in bounded memory
+{
+    int fd;          // file descriptor of input
+    char *buffer;    // buffer with part of input (grows to fit the longest line)
+    size_t capacity; // size of buffer
+    size_t begin;    // start of the next line in buffer
+    size_t end;      // end of data in buffer
+    bool eof;        // true if the whole input was read into buffer
+} stream_t;
+typedef struct // struct for definitions loaded once (by server or from snapshot), batches of commands are executed on them
+{
+    input_t input;       // definitions or mapped snapshot (pointers to lines of current batch follow their lines)
+    int count;           // count of lines with definitions (commands of batch are numbered from it)
+    int capacity;        // size of arrays indexed by lines
+    arena_t arena;       // memory for universum and parsed definitions
+    arena_t scratch;     // memory for temporaries of commands
+    symtab_t *universum; // interned universum
+    def_t *defs;         // parsed definitions and kept results of commands of current batch
+    int *firstUse;       // the first command referring to every line
+    int *lastUse;        // the last command referring to every line
+    int jobs;            // count of threads executing commands of batch
+    parsing_t *threads;  // threads which parsed definitions (their arenas keep definitions)
+} server_t;
+typedef struct // struct for state of --watch kept between versions of watched file
+{
+    string path;         // watched file
+    int count;           // count of lines of the last version (0 if it wasn't executed without error, the next one is executed whole)
+    int capacity;        // size of arrays indexed by lines
+    arena_t arena;       // memory for universum
+    arena_t scratch;     // memory for temporaries of commands
+    symtab_t *universum; // interned universum
+    def_t *defs;         // definitions and results of commands which other commands refer to (every one has own memory)
+    int *firstUse;       // the first command referring to every line
+    int *lastUse;        // the last command referring to every line
+    uint64_t *lines;     // hash of every line (changed lines are found by them)
+    uint64_t *outputs;   // hash of output of every command (only changed outputs are printed)
+    bool *dirty;         // true if line changed or if command refers to line which is dirty
+    output_t result;     // output of current command
+} watch_t;
+typedef struct // struct for parameters of generated input (--gen key=value,key=value)
+{
+    uint32_t universe; // count of elements of universum
+    int sets;          // count of sets
+    double density;    // probability that element is in set
+    int relations;     // count of relations
+    uint64_t pairs;    // count of pairs of every relation (0 - the same as count of elements)
+    string shape;      // shape of relations: random, chain, complete, functional or bijective
+    int commands;      // count of commands (every command of mix is used in turn)
+    string mix;        // commands: all, sets, relations or names of commands joined by +
+    uint64_t seed;     // seed of random generator
+} gen_t;
+typedef struct // header of snapshot (binary file with parsed definitions, it is mapped and used without parsing)
+{
+    char magic[8];      // SNAPSHOT_MAGIC
+    uint32_t version;   // SNAPSHOT_VERSION
+    uint32_t lineCount; // count of lines with definitions (the first one is universum)
+    uint64_t size;      // size of the whole file
+    uint64_t checksum;  // checksum of the file after header
+    uint64_t symbols;   // offset of symbol table of universum (names, lengths, slots and pool)
+    uint32_t count;     // count of elements of universum
+    uint32_t mask;      // size of hash table of universum - 1
+    uint64_t poolSize;  // size of pool with names of elements
+} snapshot_t;
+typedef struct // line of snapshot
+{
+    uint32_t kind;   // U, S or R
+    uint32_t count;  // count of elements of set or count of pairs of relation
+    uint32_t size;   // count of containers of set
+    uint32_t words;  // count of words of containers of set
+    uint64_t offset; // offset of containers and their words (set, universum is set too) or offset of pairs of relation
+} record_t;
+typedef struct // struct for set expression compiled into postfix order (evaluated by one pass over words of operands)
+{
+    string code;                // instructions: OPERAND pushes the next operand, ~ & | - are applied on the top of stack
+    const set_t **operands;     // sets of operands in the order of pushes
+    int depth;                  // maximal count of values on stack
+} program_t;
+typedef union // argument of command (its kind is given by descriptor of command)
+{
+    set_t *set;
+    rel_t *rel;
+    program_t *program;
+} arg_t;
+typedef struct // struct for descriptor of command (or other restricted word)
+{
+    string name;                                 // name like "minus" or "intersect"
+    string kinds;                                // kinds of arguments (S - set, R - relation, E - expression), NULL if word isn't command
+    int (*handler)(context_t *ctx, arg_t *args); // function which executes command
+    bool commutative;                            // true if order of arguments doesn't change result
+} command_t;
 typedef struct // struct for commands
 {
-    string command;     // type of command like "minus" or "intersect"
-    int arguments[3];   // arguments (indexes)
+    const command_t *command; // descriptor of command like "minus" or "intersect"
+    int arguments[MAX_OPERANDS]; // arguments (indexes), for expression they are its operands
     int argumentLength; // arguments count
+    string source;      // set expression (only for command with expression)
 } exp_t;
-// error handler
-void ThrowError(const int errorCode)
+typedef struct // struct for output of command kept in cache
+{
+    uint32_t hash;
+    char *key;        // command and its arguments (NULL if entry is empty)
+    size_t keyLength;
+    char *data;       // printed output of command
+    size_t size;
+} entry_t;
+typedef struct // struct for cache of outputs of commands (the same command with the same arguments is executed once)
+{
+    entry_t *entries;     // open addressing hash table
+    size_t mask;          // size of hash table - 1 (size is a power of 2)
+    size_t count;         // count of entries
+    size_t bytes;         // bytes of outputs in cache
+    size_t lookups;       // count of commands looked up in cache
+    size_t hits;          // count of commands found in cache
+    int lines;            // only commands referring to lines before it are cached (server changes the next lines by every batch)
+    arena_t arena;        // memory for keys and outputs
+    pthread_mutex_t lock; // lock for cache (commands can be executed by more threads)
+} cache_t;
+typedef struct // struct for statistics of run printed by --stats (phases are switched by the main thread only)
+{
+    bool enabled;               // true if statistics are collected
+    int phase;                  // current phase
+    uint64_t wall[PHASE_COUNT]; // wall time of every phase in nanoseconds
+    uint64_t cpu[PHASE_COUNT];  // CPU time of every phase (of all the threads) in nanoseconds
+    uint64_t wallMark;          // wall time when current phase began
+    uint64_t cpuMark;           // CPU time when current phase began
+    counters_t counters;        // counters of the main thread and of threads which already ended
+    size_t allocated;           // bytes allocated by arenas (added when arena is freed)
+    size_t written;             // bytes written by outputs (added when output is freed)
+    pthread_mutex_t lock;       // lock for adding counters of other threads
+} stats_t;
+typedef struct // struct for details about error (printed after error message)
+{
+    int line;       // number of line where the error was found (from 1)
+    string element; // element which caused the error (NULL if there are no details)
+} errinfo_t;
+errinfo_t errorInfo; // details about the last error
+pthread_mutex_t errorLock = PTHREAD_MUTEX_INITIALIZER; // lock for errorInfo (definitions can be parsed by more threads)
+// prints error message with details about the error (without new line)
+void PrintError(const int errorCode)
 {
     switch (errorCode)
     {
@@ -158,228 +511,462 @@ void ThrowError(const int errorCode)
     case ELEM_NOT_DEFINED:
         fprintf(stderr, "Element is not defined in universum");
         break;
-    case LINE_LIMIT_ERR:
-        fprintf(stderr, "You have reached limit (1000 lines)");
-        break;
     }
+    if (errorInfo.element != NULL) // prints out which element caused the error
+        fprintf(stderr, ": %s on line %d", errorInfo.element, errorInfo.line);
+}
+
+// error handler
+void ThrowError(const int errorCode)
+{
+    PrintError(errorCode);
     exit(errorCode);
 }
 
 // prototypes
 
 // functions to validate string before converting in structures
-int ValidateStringSet(string str, set_t *universum);
-int ValidateStringRelation(string str, set_t *universum);
+int ValidateUniversum(string str, symtab_t *dest, arena_t *arena);                         // validates universum and interns its elements
+int ValidateStringSet(string str, symtab_t *universum, set_t **dest, arena_t *arena);      // dest is parsed set (if it isn't NULL)
+int ValidateStringRelation(string str, symtab_t *universum, rel_t **dest, arena_t *arena); // dest is parsed relation (if it isn't NULL)
+int ParseDefinition(string str, int line, symtab_t *universum, def_t *dest, arena_t *arena); // validates and parses line with definition (line is index of it)
+void FreeDefinition(def_t *def);
+int KeepDefinition(def_t **defs, int *capacity, int line, def_t *def);                      // stores definition into array indexed by lines
 
 // functions to convert string to specific structure
-int StringToSet(string str, set_t *set); // converts string to set
-int StringToRelation(string str, rel_t *dest);
+int StringToSet(string str, set_t *set, symtab_t *universum, arena_t *arena); // converts string to set
+int StringToRelation(string str, rel_t *dest, symtab_t *universum, arena_t *arena);
 int StringToExpression(string str, exp_t *dest); // converts string to expression
+int CompileExpression(exp_t *expression, def_t *defs, int defCount, arena_t *arena, program_t **dest); // compiles set expression of command
+
+// functions for arena allocator
+void ArenaInit(arena_t *arena, size_t blockSize);
+void *ArenaAlloc(arena_t *arena, size_t size);  // returns NULL if memory can't be allocated
+void *ArenaCalloc(arena_t *arena, size_t size); // same as ArenaAlloc, but memory is filled with zeros
+void ArenaReset(arena_t *arena);                // releases all the allocations, but keeps memory for the next ones
+mark_t ArenaMark(arena_t *arena);               // returns current position in arena
+void ArenaRelease(arena_t *arena, mark_t mark); // releases all the allocations made after mark
+void ArenaFree(arena_t *arena);                 // gives all the memory back to the system
+
+// functions for output
+int OutputInit(output_t *out, int fd, size_t capacity);         // prepares buffer for output
+void OutputWrite(output_t *out, const char *data, size_t size); // appends data into buffer
+void OutputString(output_t *out, const char *str);
+void OutputChar(output_t *out, char ch);
+void OutputNumber(output_t *out, size_t number);
+void OutputLine(output_t *out, const char *line); // writes line with new line (long lines are written without copying)
+void OutputFlush(output_t *out);                  // writes the whole buffer
+void OutputFree(output_t *out);
+
+// functions for input
+int LoadInput(string path, input_t *dest);      // maps or reads whole input and splits it into lines
+int ReadInput(int fd, input_t *dest, bool map); // same as LoadInput, but input is already opened (it is always read if map is false)
+void FreeInput(input_t *input);
+int OpenStream(string path, stream_t *dest);  // opens input for reading line by line
+int ReadLine(stream_t *stream, string *line); // reads next line (line is NULL at the end of input)
+void CloseStream(stream_t *stream);
+
+// functions for universum (symbol table)
+uint32_t HashString(const char *str, int length);
+uint32_t LookupElement(symtab_t *universum, const char *str, int length); // returns ID of element or NOT_FOUND
+
+// functions for bitsets
+void InitKernels(void);            // selects bitset kernels by CPU features
+void Transpose64(uint64_t *block); // transposes 64x64 bit matrix (one word is one row)
+
+// functions for sets (containers of chunks)
+int SetFromIds(const uint32_t *ids, uint32_t count, set_t *dest, arena_t *arena);                        // IDs have to be sorted and unique
+int SetFromBits(const uint64_t *bits, size_t words, set_t *dest, arena_t *arena, arena_t *scratch);      // bitset has to have whole chunks
+int SetOperation(const set_t *a, const set_t *b, char operation, set_t *dest, arena_t *arena, arena_t *scratch); // | union, & intersect, - minus
+bool SetSubseteq(const set_t *a, const set_t *b, uint64_t *chunks); // chunks are 2 * CHUNK_WORDS words for converted containers
+bool SetEqual(const set_t *a, const set_t *b, uint64_t *chunks);
+void ChunkBits(const set_t *set, const container_t *container, uint64_t *bits); // converts container into CHUNK_WORDS words of bitmap
+uint64_t *SetBits(const set_t *set, size_t words, arena_t *arena);              // converts set into bitset (NULL if memory can't be allocated)
+void PrintSet(output_t *out, symtab_t *universum, const set_t *set, char type); // prints set (or other type of line) with names of elements
+
+// count of bits in a word and index of the lowest bit set in a word
+#ifdef __GNUC__
+#define Popcount64(word) ((size_t)__builtin_popcountll(word))
+#define Ctz64(word) ((size_t)__builtin_ctzll(word))
+#else
+size_t Ctz64(uint64_t word);
+size_t Popcount64(uint64_t word);
+#endif
+
+// functions for cache of commands
+char *CacheKey(cache_t *cache, exp_t *expression, arena_t *arena, size_t *length);   // builds key of command (arguments of commutative command are sorted)
+bool CacheGet(cache_t *cache, const char *key, size_t length, output_t *out);        // writes cached output of command (false if it isn't in cache)
+void CachePut(cache_t *cache, const char *key, size_t length, const char *data, size_t size); // keeps output of command
+void CacheStats(cache_t *cache);                                                     // prints hit rate of cache
+void CacheFree(cache_t *cache);
+
+// functions for statistics of run (--stats)
+uint64_t Now(clockid_t clock);              // returns time of clock in nanoseconds
+void StatsStart(stats_t *stats);            // starts measuring of the first phase (load)
+void StatsPhase(stats_t *stats, int phase); // adds time since the last switch to current phase and switches to phase
+counters_t *StatsCounters(stats_t *stats);  // returns counters of the main thread (NULL if statistics aren't collected)
+void StatsCommand(counters_t *counters, const command_t *command, uint64_t start); // counts command which began at start
+void StatsMerge(stats_t *stats, const counters_t *counters);         // adds counters of thread which ends
+void StatsBytes(stats_t *stats, size_t allocated, size_t written);   // adds bytes of freed arena or of freed output
+int StatsPrint(stats_t *stats, cache_t *cache, string path);         // prints statistics to standard error output (or as JSON into file)
 
 // extra functions
-bool isUniversumElement(string str, set_t *universum);
-bool EqualStrings(string *strs, int size);
-bool isRestricted(string str);
-
-int CommandExecution(string *lines, int size); // executes command
+int NextElement(string *cursor, string *element); // finds next element separated by spaces
+int UniquePairs(symtab_t *universum, rel_t *rel, arena_t *arena);   // returns SAME_ELEMENT_ERR if relation has 2 same pairs
+int SameElementError(symtab_t *universum, uint32_t id, uint32_t second); // remembers duplicate element (or pair) for error message
+int InitCommands(void);                                    // fills slots of restricted words (EXIT_FAILURE if 2 of them have the same slot)
+const command_t *FindCommand(const char *str, int length); // returns descriptor of restricted word or NULL
+
+int CheckLines(string *lines, int lineCount);                                     // checks that there are definitions and commands after them
+int CommandExecution(string *lines, int size, int jobs);                          // executes command
+int ExecuteCommand(string str, def_t *defs, int defCount, context_t *ctx);         // executes one command (or copies its output from cache)
+int StreamExecution(string path);                                                  // executes commands while the input is being read
+int ExecuteLines(string *lines, int lineCount, int begin, def_t *defs, int *firstUse, int *lastUse, context_t *ctx, arena_t *arena, int jobs); // executes lines from begin
+void FindReferences(string *lines, int begin, int lineCount, int *firstUse, int *lastUse); // finds the first and the last command referring to every line
+void ReleaseResults(string *lines, int begin, int end, def_t *defs, int *lastUse); // frees kept results after their last use
+int CountReferences(stream_t *stream, int **lastUse, int *lineCount);              // finds the last command referring to every line
+int ParallelExecution(string *lines, int lineCount, int begin, int end, def_t *defs, int *firstUse, context_t *ctx, int jobs); // executes commands by more threads
+void *Worker(void *arg);                       // thread which executes commands from queues
+int TakeTask(pool_t *pool, int id);             // returns next command from own queue or steals it from other queue (-1 if there is none)
+void WriteResults(pool_t *pool);                // writes output of finished commands in the order of lines
+int ParallelParsing(parser_t *parser, parsing_t *threads, int jobs); // parses definitions by more threads, returns the first line with error
+void *ParseWorker(void *arg);                   // thread which parses chunks of definitions
+int ServeExecution(string path, string address, string snapshot, int jobs); // loads definitions once and answers batches of commands sent over socket
+int LoadDefinitions(server_t *server, string path); // parses file with definitions only
+void FreeDefinitions(server_t *server);
+int ExecuteBatch(server_t *server, input_t *batch, output_t *out); // executes commands numbered like lines appended to the definitions
+int ServeBatch(server_t *server, int client);   // executes batch of commands sent by client and sends their output back
+void StopServer(int signal);                    // handler of signals which stop server (or watching of file)
+int ClientExecution(string path, string address); // sends commands to server and prints their output
+int SnapshotExecution(string path, string snapshot, bool save, int jobs); // saves definitions into snapshot or executes commands on it
+int SaveSnapshot(server_t *server, string path); // writes parsed definitions into binary file
+int LoadSnapshot(server_t *server, string path); // maps binary file with definitions
+uint64_t Checksum(const uint64_t *words, size_t count);
+int BenchExecution(string *lines, int lineCount, int reps, bool json); // executes every command reps times and prints percentiles of times
+int GenerateInput(string spec);                                        // writes random input given by spec to standard output
+int WatchExecution(string path);                                       // executes file again whenever it is changed
+int WatchRun(watch_t *watch, string *lines, int lineCount, output_t *out); // executes new version of file (only what it changed)
+bool WaitChange(watch_t *watch, int fd);                               // waits till watched file is changed (false if watching stopped)
+void FreeWatch(watch_t *watch);
+
+kernels_t kernels; // bitset kernels used by set commands
+volatile sig_atomic_t stopped = 0; // true if server got signal to stop
+cache_t cache = {NULL, 0, 0, 0, 0, 0, INT_MAX, {NULL, NULL, ARENA_BLOCK, 0}, PTHREAD_MUTEX_INITIALIZER}; // outputs of commands executed in this run
+stats_t stats = {.lock = PTHREAD_MUTEX_INITIALIZER}; // statistics of this run (collected only with --stats)
+const string PHASE_NAMES[PHASE_COUNT] = {"load", "universum", "definitions", "commands", "output", "wait"};
 
 // command functions (prototypes)
-int Empty(set_t *set1); // is Empty
-int Card(set_t *set);
-int Complement(set_t *universum, set_t *set);
-int Union(set_t *set1, set_t *set2);
-int Intersect(set_t *set1, set_t *set2);
-int Minus(set_t *set1, set_t *set2);
-int Subseteq(set_t *set1, set_t *set2);
-int Subset(set_t *set1, set_t *set2);
-int Equals(set_t *set1, set_t *set2);
-
-int Reflexive(rel_t *rel, set_t *universum);
-int Symmetric(rel_t *rel);
-int Antisymmetric(rel_t *rel);
-int Transitive(rel_t *rel);
-int Function(rel_t *rel);
-int Domain(rel_t *rel);
-int Codomain(rel_t *rel);
-int Injective(rel_t *rel, set_t *set1, set_t *set2);
-int Surjective(rel_t *rel, set_t *set1, set_t *set2);
-int Bijective(rel_t *rel, set_t *set1, set_t *set2);
+int Empty(context_t *ctx, arg_t *args); // is Empty
+int Card(context_t *ctx, arg_t *args);
+int Complement(context_t *ctx, arg_t *args);
+int Union(context_t *ctx, arg_t *args);
+int Intersect(context_t *ctx, arg_t *args);
+int Minus(context_t *ctx, arg_t *args);
+int Subseteq(context_t *ctx, arg_t *args);
+int Subset(context_t *ctx, arg_t *args);
+int Equals(context_t *ctx, arg_t *args);
+int Eval(context_t *ctx, arg_t *args);
+
+int Reflexive(context_t *ctx, arg_t *args);
+int Symmetric(context_t *ctx, arg_t *args);
+int Antisymmetric(context_t *ctx, arg_t *args);
+int Transitive(context_t *ctx, arg_t *args);
+int Function(context_t *ctx, arg_t *args);
+int Domain(context_t *ctx, arg_t *args);
+int Codomain(context_t *ctx, arg_t *args);
+int Injective(context_t *ctx, arg_t *args);
+int Surjective(context_t *ctx, arg_t *args);
+int Bijective(context_t *ctx, arg_t *args);
+int ClosureTrans(context_t *ctx, arg_t *args);
+int ClosureRefl(context_t *ctx, arg_t *args);
+int ClosureSym(context_t *ctx, arg_t *args);
+int ClosureEquiv(context_t *ctx, arg_t *args);
+int Compose(context_t *ctx, arg_t *args);
+int Inverse(context_t *ctx, arg_t *args);
+int Restrict(context_t *ctx, arg_t *args);
+
+// descriptors of commands and other restricted words (elements can't have these names)
+const command_t COMMANDS[COMMAND_COUNT] = {
+    {EMPTY, "S", Empty, false},
+    {CARD, "S", Card, false},
+    {COMPLEMENT, "S", Complement, false},
+    {UNION, "SS", Union, true},
+    {INTERSECT, "SS", Intersect, true},
+    {MINUS, "SS", Minus, false},
+    {SUBSETEQ, "SS", Subseteq, false},
+    {SUBSET, "SS", Subset, false},
+    {EQUALS, "SS", Equals, true},
+    {EVAL, "E", Eval, false},
+    {_TRUE, NULL, NULL, false},
+    {_FALSE, NULL, NULL, false},
+    {REFLEXIVE, "R", Reflexive, false},
+    {SYMMETRIC, "R", Symmetric, false},
+    {ANTISYMMETRIC, "R", Antisymmetric, false},
+    {TRANSITIVE, "R", Transitive, false},
+    {FUNCTION, "R", Function, false},
+    {DOMAIN, "R", Domain, false},
+    {CODOMAIN, "R", Codomain, false},
+    {INJECTIVE, "RSS", Injective, false},
+    {SURJECTIVE, "RSS", Surjective, false},
+    {BIJECTIVE, "RSS", Bijective, false},
+    {CLOSURE_TRANS, "R", ClosureTrans, false},
+    {CLOSURE_REFL, "R", ClosureRefl, false},
+    {CLOSURE_SYM, "R", ClosureSym, false},
+    {CLOSURE_EQUIV, "R", ClosureEquiv, false},
+    {COMPOSE, "RR", Compose, false},
+    {INVERSE, "R", Inverse, false},
+    {RESTRICT, "RS", Restrict, false},
+};
+
+// perfect hash of restricted words, CommandHash gives different slot for each of them (slot stores index in COMMANDS + 1).
+// Slots are filled from COMMANDS by InitCommands, which refuses to start if a new restricted word has the slot of other one
+// (then constants of CommandHash have to be changed)
+#define COMMAND_SLOTS 64
+#define CommandHash(str, length) (((length) * 2 + (str)[0] + (str)[(length) - 1] * 25) & (COMMAND_SLOTS - 1))
+uint8_t commandIndex[COMMAND_SLOTS];
 
 // start here.
 int main(int argc, char **argv)
 {
-    FILE *fp;      // file pointer
-    string *lines; // all the lines from the file
+    input_t input; // all the lines from the file
 
-    int linesCount = 0; // count of lines
-    int strLength = 0;  // line's length
-    int chr;            // character for reading file by symbol
-
-    void *error; // variable to hold the reference of the memory that is being allocated (to check if memory was allocated)
     int errorCode = 0;
-
-    int commandBegin = 0;
-    int setBegin = 0;
-
-    if (argc != 2)            // if we have more or less than 2 arguments
-        ThrowError(ARGS_ERR); // throws error
-
-    fp = fopen(argv[1], MODE);
-
-    if (fp == NULL)           // if we can't open file (wrong name or something like this, fp will recieve value NULL from fopen function)
-        ThrowError(FILE_ERR); // throws error
-
-    if (allocate(lines, sizeof(string))) // allocates memory for array of strings
-        ThrowError(MEMORY_ERR);          // throws error
-
-    if (allocate(lines[linesCount], sizeof(char))) // allocates memory for temp string
-    {
-        free(lines);            // frees memory of lines
-        fclose(fp);             // closes the file
-        ThrowError(MEMORY_ERR); // throws error
-    }
-    while ((chr = getc(fp)) != EOF) // reads file by symbol
+    int statsError; // error of writing statistics
+
+    string path = NULL;  // name of input file
+    bool stream = false; // true if commands are executed while the input is being read
+    int jobs = 1;        // count of threads executing commands
+    bool cacheStats = false; // true if hit rate of cache is printed at the end
+    string statsPath = NULL; // JSON file with statistics of run (NULL - they are printed to standard error output)
+    string address = NULL; // path of Unix domain socket of server
+    bool serve = false;    // true if this process is server (false if it is client)
+    string snapshot = NULL; // path of binary file with parsed definitions
+    bool save = false;      // true if snapshot is written (false if it is loaded)
+    string spec = NULL;     // spec of generated input
+    int reps = 0;           // count of measured runs of every command (0 - commands aren't measured)
+    bool json = false;      // true if times of commands are printed as JSON
+    bool watch = false;     // true if file is executed again whenever it is changed
+
+    InitKernels();
+    if (InitCommands())
+        return EXIT_FAILURE;
+
+    for (int i = 1; i < argc; i++)
     {
-        if (chr != '\n') // when symbol is equal to konec radku
+        if (!strcmp(argv[i], STREAM_OPTION))
+            stream = true;
+        else if (!strcmp(argv[i], CACHE_STATS_OPTION))
+            cacheStats = true;
+        else if (!strcmp(argv[i], STATS_OPTION))
+            stats.enabled = true;
+        else if (!strcmp(argv[i], STATS_JSON_OPTION) && i + 1 < argc && statsPath == NULL)
         {
-
-            lines[linesCount][strLength++] = chr;                      // reading file
-            if (reallocate(error, lines[linesCount], (strLength + 1))) // resizes str
-            {
-                errorCode = MEMORY_ERR;
-                break;
-            }
-
-            lines[linesCount] = error; // if there is no error set pointer back to str
+            stats.enabled = true;
+            statsPath = argv[++i];
         }
-        else // otherwise
+        else if (!strcmp(argv[i], JOBS_OPTION) && i + 1 < argc && (jobs = atoi(argv[i + 1])) > 0 && jobs <= MAX_JOBS)
+            i++;
+        else if (!strcmp(argv[i], BENCH_OPTION) && i + 1 < argc && (reps = atoi(argv[i + 1])) > 0)
+            i++;
+        else if (!strcmp(argv[i], BENCH_JSON_OPTION))
+            json = true;
+        else if (!strcmp(argv[i], WATCH_OPTION))
+            watch = true;
+        else if (!strcmp(argv[i], GEN_OPTION) && i + 1 < argc && spec == NULL)
+            spec = argv[++i];
+        else if ((!strcmp(argv[i], SERVE_OPTION) || !strcmp(argv[i], CLIENT_OPTION)) && i + 1 < argc && address == NULL)
         {
-            if (linesCount > MAX_LINES) // limit
-            {
-                errorCode = LINE_LIMIT_ERR;
-                break;
-            }
-            reset(lines[linesCount][strLength]); // reset function just assigns 0 to a passed argument
-            reset(strLength);
+            serve = !strcmp(argv[i], SERVE_OPTION);
+            address = argv[++i];
+        }
+        else if ((!strcmp(argv[i], SAVE_SNAPSHOT_OPTION) || !strcmp(argv[i], LOAD_SNAPSHOT_OPTION)) && i + 1 < argc && snapshot == NULL)
+        {
+            save = !strcmp(argv[i], SAVE_SNAPSHOT_OPTION);
+            snapshot = argv[++i];
+        }
+        else if (path == NULL && (argv[i][0] != '-' || !strcmp(argv[i], STDIN)))
+            path = argv[i];
+        else                      // unknown option or more than 1 file
+            ThrowError(ARGS_ERR); // throws error
+    }
+    // server takes definitions from file or from snapshot, client doesn't use snapshot
+    if (snapshot != NULL && address != NULL && (!serve || save || path != NULL))
+        ThrowError(ARGS_ERR);
+    // generator has no input, benchmark executes the whole file (--bench-json only changes format of its times)
+    if ((spec != NULL && (path != NULL || stream || address != NULL || snapshot != NULL || reps || json || stats.enabled || watch)) ||
+        ((reps || json) && (!reps || stream || address != NULL || snapshot != NULL)))
+        ThrowError(ARGS_ERR);
+    // watched file is named and its commands are executed one after another
+    if (watch && (path == NULL || !strcmp(path, STDIN) || stream || address != NULL || snapshot != NULL || reps || jobs > 1))
+        ThrowError(ARGS_ERR);
+    if (spec != NULL)
+    {
+        if ((errorCode = GenerateInput(spec)))
+            ThrowError(errorCode);
+        return EXIT_SUCCESS;
+    }
+    // without file name (or with -) input is read from standard input
+    if (path == NULL)
+        path = STDIN;
+    StatsStart(&stats);
 
-            if (lines[linesCount][0] == COMMAND)
-            {
-                commandBegin = linesCount;
-            }
-            else if (lines[linesCount][0] == SET || lines[linesCount][0] == RELATION)
-            {
-                setBegin = linesCount;
-                if (setBegin > commandBegin && commandBegin)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
-            }
+    if (stream || address != NULL || snapshot != NULL || watch)
+    {
+        if (watch) // the first version of file is printed whole, the next ones only print changed results
+            errorCode = WatchExecution(path);
+        else if (address != NULL && serve) // file (or snapshot) has only definitions, commands are sent by clients
+            errorCode = ServeExecution(path, address, snapshot, jobs);
+        else if (address != NULL) // file has only commands
+            errorCode = ClientExecution(path, address);
+        else if (snapshot != NULL) // file has only definitions (saved) or only commands (executed on loaded definitions)
+            errorCode = SnapshotExecution(path, snapshot, save, jobs);
+        else
+            errorCode = StreamExecution(path);
+        if (cacheStats)
+            CacheStats(&cache);
+        CacheFree(&cache);
+        if (stats.enabled && (statsError = StatsPrint(&stats, &cache, statsPath)) && !errorCode) // statistics are printed after error too
+            errorCode = statsError;
+        if (errorCode)
+            ThrowError(errorCode);
+        return EXIT_SUCCESS;
+    }
 
-            linesCount++;
+    if ((errorCode = LoadInput(path, &input)))
+        ThrowError(errorCode); // throws error
 
-            // resizes memory for lines (adds one more element to it)
-            if (reallocate(error, lines, (linesCount + 1) * sizeof(string)))
-            {
-                errorCode = MEMORY_ERR;
-                break;
-            }
-            // error - is a variable to store error if there is one
-            lines = error;                                 // if there was no error (error wasn't equal to NULL, than it has reference to newly reallocated memory)
-            if (allocate(lines[linesCount], sizeof(char))) // allocates memory for a new characters in a line by index
-            {
-                errorCode = MEMORY_ERR;
-                break;
-            }
-            // if somewhere was an error, loop will break
-        }
-    }
-    // at this poind we have all the file stored by lines in "lines" variable or got an error
-    if (!commandBegin || !setBegin)
-        errorCode = ARGS_ERR;
+    // at this poind we have all the file stored by lines in "input" variable or got an error
+    errorCode = CheckLines(input.lines, input.count);
 
-    if (!errorCode)                                      // if there was no error we will get to main code
-        errorCode = CommandExecution(lines, linesCount); // executing commands
+    if (!errorCode && reps) // commands are measured instead of printing their output
+        errorCode = BenchExecution(input.lines, input.count, reps, json);
+    else if (!errorCode)                                              // if there was no error we will get to main code
+        errorCode = CommandExecution(input.lines, input.count, jobs); // executing commands
 
-    // frees each pointer to a line in lines (array of lines)
-    for (int i = 0; i < linesCount + 1; i++) // linesCount + 1 because on last iteration we allocate memory for another line (which is not necessary and should be fixed..)
-        free(lines[i]);
-    free(lines);   // frees
-    fclose(fp);    // closes the file
+    FreeInput(&input);
+    if (cacheStats)
+        CacheStats(&cache);
+    CacheFree(&cache);
+    if (stats.enabled && (statsError = StatsPrint(&stats, &cache, statsPath)) && !errorCode) // statistics are printed after error too
+        errorCode = statsError;
     if (errorCode) // if there is an error it will throw it with a message
         ThrowError(errorCode);
     return EXIT_SUCCESS;
 }
 
-int ValidateStringSet(string str, set_t *universum)
+int ValidateUniversum(string str, symtab_t *dest, arena_t *arena)
 {
-    int errorCode = 0; // variable for errorCodes (to be more precise about type of an error)
+    int errorCode; // variable for errorCodes (to be more precise about type of an error)
 
-    if (universum != NULL && str[0] == UNIVERSUM) // if universum isn't null and the string is for universum it means that it's the second universum
-        return ARGS_ERR;
-    if (strlen(str) == 1) //
-        return EXIT_SUCCESS;
-    if (str[1] != ' ' || str[strlen(str) - 1] == ' ') // if the second character or the last one isn't or IS a MEZERO
+    if (str[0] != UNIVERSUM)
         return ARGS_ERR;
-    for (int i = 1; i < (int)strlen(str); i++)
-        if (!isValidChar(str[i]) || (str[i - 1] == ' ' && str[i - 1] == str[i])) // if string doesn't have any symbols or 2 MEZERA in a row
-            return ARGS_ERR;
+    if ((errorCode = ValidateStringSet(str, NULL, NULL, arena))) // checks syntax of universum
+        return errorCode;
 
-    set_t *set;                       // temp set
-    if (allocate(set, sizeof(set_t))) // allocates memory for set
-        return MEMORY_ERR;
+    reset(dest->count);
 
-    if (StringToSet(str, set)) // converts it to set
-    {
-        FreeSet(set); // frees set (macro)
+    uint32_t capacity = 1; // count of elements is at most count of spaces in the string
+
+    for (int i = 0; str[i]; i++)
+        if (str[i] == ' ')
+            capacity++;
+    // hash table is at least twice as big as count of elements (size is a power of 2)
+    for (dest->mask = 1; dest->mask < capacity * 2; dest->mask <<= 1)
+        ;
+
+    if ((dest->names = ArenaAlloc(arena, capacity * sizeof(uint64_t))) == NULL)
         return MEMORY_ERR;
-    }
+    if ((dest->lengths = ArenaAlloc(arena, capacity * sizeof(uint32_t))) == NULL)
+        return MEMORY_ERR;
+    if ((dest->pool = ArenaAlloc(arena, strlen(str) + 1)) == NULL) // names are never longer than the whole line
+        return MEMORY_ERR;
+    if ((dest->slots = ArenaCalloc(arena, dest->mask * sizeof(uint32_t))) == NULL)
+        return MEMORY_ERR;
+    dest->mask--;
 
-    // checks if set has the same elements
-    if (EqualStrings(set->elements, set->count))
-    {
-        FreeSet(set); // frees set (macro)
-        return ARGS_ERR;
-    }
+    string cursor = str + 1; // skips U
+    string element;
+    string next = dest->pool; // place for the next name in pool
+    int length;
 
-    // loop to check if set has restricted words assigned as elements
-    for (int i = 0; i < set->count; i++)
+    while ((length = NextElement(&cursor, &element)))
     {
-        if (isRestricted(set->elements[i]))
+        uint32_t slot = HashString(element, length) & dest->mask;
+        for (; dest->slots[slot]; slot = (slot + 1) & dest->mask)
         {
-            FreeSet(set);
-            return ARGS_ERR;
+            string name = ElementName(dest, dest->slots[slot] - 1);
+            if (!strncmp(name, element, length) && name[length] == '\0') // universum has 2 same elements
+                return SameElementError(dest, dest->slots[slot] - 1, NOT_FOUND);
         }
+
+        dest->names[dest->count] = next - dest->pool; // copies the name into pool
+        dest->lengths[dest->count] = length;
+        memcpy(next, element, length);
+        reset(next[length]);
+        next += length + 1;
+
+        if (FindCommand(element, length) != NULL) // restricted words can't be elements
+            return ARGS_ERR;
+        dest->count++;
+        dest->slots[slot] = dest->count; // stores ID + 1
     }
 
-    // loop to check if all the values also exist at universum if it exists
-    if (universum != NULL)
+    // set with all the elements of universum (needed for complement), every chunk is one run
+    uint32_t chunks = (dest->count + (1 << CHUNK_BITS) - 1) >> CHUNK_BITS;
+    dest->words = BitsetWords(dest->count);
+    if ((dest->set = ArenaAlloc(arena, sizeof(set_t))) == NULL || (dest->set->containers = ArenaAlloc(arena, chunks * sizeof(container_t))) == NULL ||
+        (dest->set->data = ArenaCalloc(arena, chunks * sizeof(uint64_t))) == NULL)
+        return MEMORY_ERR;
+    dest->set->size = chunks;
+    dest->set->count = dest->count;
+    for (uint32_t key = 0; key < chunks; key++)
     {
-        for (int i = 0; i < set->count; i++)
-        {
-            if (!isUniversumElement(set->elements[i], universum))
-            {
-                FreeSet(set);
-                return ARGS_ERR;
-            }
-        }
+        uint32_t count = dest->count - (key << CHUNK_BITS) < (1 << CHUNK_BITS) ? dest->count - (key << CHUNK_BITS) : (1 << CHUNK_BITS);
+        uint16_t *run = (uint16_t *)(dest->set->data + key);
+        dest->set->containers[key] = (container_t){key, count, 1, RUN_CONTAINER, key};
+        run[1] = count - 1;
     }
+    return EXIT_SUCCESS;
+}
+
+int ValidateStringSet(string str, symtab_t *universum, set_t **dest, arena_t *arena)
+{
+    int errorCode = 0;        // variable for errorCodes (to be more precise about type of an error)
+    int length = strlen(str); // length of string passed in
+
+    if (universum != NULL && str[0] == UNIVERSUM) // if universum isn't null and the string is for universum it means that it's the second universum
+        return ARGS_ERR;
+    if (length != 1 && (str[1] != ' ' || str[length - 1] == ' ')) // if the second character or the last one isn't or IS a MEZERO
+        return ARGS_ERR;
+    for (int i = 1; i < length; i++)
+        if (!isValidChar(str[i]) || (str[i - 1] == ' ' && str[i - 1] == str[i])) // if string doesn't have any symbols or 2 MEZERA in a row
+            return ARGS_ERR;
+
+    if (universum == NULL) // elements of universum are checked when they are interned
+        return EXIT_SUCCESS;
 
-    // frees set
-    FreeSet(set);
+    set_t *set; // parsed set
+    if ((set = ArenaAlloc(arena, sizeof(set_t))) == NULL) // allocates memory for set
+        return MEMORY_ERR;
+
+    // converts it to set (also checks if all the values exist at universum and if set doesn't have the same elements)
+    if ((errorCode = StringToSet(str, set, universum, arena)))
+        return errorCode;
+
+    // keeps parsed set for commands
+    if (dest != NULL)
+        *dest = set;
     return errorCode;
 }
 
 // Next 2 functions are for validation
 
-int ValidateStringRelation(string str, set_t *universum)
+int ValidateStringRelation(string str, symtab_t *universum, rel_t **dest, arena_t *arena)
 {
     int errorCode = 0;        // variable for errorCodes (to be more precise about type of an error)
     int length = strlen(str); // length of string passed in
 
-    if (strlen(str) == 1) //
-        return EXIT_SUCCESS;
-    if (str[1] != ' ' || str[length - 1] == ' ') // if the second symbol in string or the last one is equal to a MEZERO
+    if (length != 1 && (str[1] != ' ' || str[length - 1] == ' ')) // if the second symbol in string or the last one is equal to a MEZERO
         return ARGS_ERR;
     for (int i = 2; i < length; i++)
     {
@@ -397,1440 +984,4970 @@ int ValidateStringRelation(string str, set_t *universum)
             return ARGS_ERR;
     }
 
-    string tempstr; // temp variable for string
-    string element; // varible to store elements separatly
+    string cursor = str + 1; // skips R
+    string element;          // start of the current element
 
-    if (allocate(tempstr, length + 1)) // allocates memory for temp string
-    {
+    // elements have to be in brackets like (a b)
+    for (int i = 0; (length = NextElement(&cursor, &element)); i++)
+        if (i % 2 == 0 ? element[0] != '(' : element[length - 1] != ')')
+            return ARGS_ERR;
+
+    rel_t *rel; // parsed relation
+
+    if ((rel = ArenaAlloc(arena, sizeof(rel_t))) == NULL)
         return MEMORY_ERR;
-    }
-    strcpy(tempstr, str); // here temp string is the same as str (now we can manipulate str, without changing it)
+    // converts it to relation (also checks if elements from relation exist in universum)
+    if ((errorCode = StringToRelation(str, rel, universum, arena)))
+        return errorCode;
 
-    element = strtok(tempstr, SPACE);
-    for (int i = 0; (element = strtok(NULL, SPACE)) != NULL; i++)
-    {
-        if (i % 2 == 0 ? element[0] != '(' : element[strlen(element) - 1] != ')')
-        {
-            errorCode = ARGS_ERR;
-            break;
-        }
-    }
+    // checks if relation doesn't have the same pair
+    if ((errorCode = UniquePairs(universum, rel, arena)))
+        return errorCode;
+
+    // keeps parsed relation for commands
+    if (dest != NULL)
+        *dest = rel;
+    return errorCode;
+}
 
-    free(tempstr); // frees temp string
+// validates and parses line with definition (universum has to be already interned)
+int ParseDefinition(string str, int line, symtab_t *universum, def_t *dest, arena_t *arena)
+{
+    dest->set = NULL;
+    dest->rel = NULL;
+    dest->source = NULL;
 
-    if (errorCode)
+    switch (str[0])
+    {
+    case UNIVERSUM: // universum can be used as set (it is already interned), but only the first line can be universum
+        if (line)
+            return ARGS_ERR;
+        dest->set = universum->set;
+        return EXIT_SUCCESS;
+    case SET: // if its S
+        return ValidateStringSet(str, universum, &dest->set, arena);
+    case RELATION: // if its R
+        return ValidateStringRelation(str, universum, &dest->rel, arena);
+    default: // if this is something else
         return ARGS_ERR;
+    }
+}
 
-    rel_t *rel; // temp relation
+// frees parsed definition (if it has its own memory)
+void FreeDefinition(def_t *def)
+{
+    ArenaFree(&def->arena);
+    def->set = NULL;
+    def->rel = NULL;
+}
 
-    if (allocate(rel, sizeof(rel_t)))
-        return MEMORY_ERR;
-    if ((errorCode = StringToRelation(str, rel)))
+// stores definition into array indexed by lines (array is resized twice if line doesn't fit into it)
+int KeepDefinition(def_t **defs, int *capacity, int line, def_t *def)
+{
+    while (line >= *capacity)
     {
-        FreeRelation(rel);
-        return errorCode;
+        void *error;
+        if (reallocate(error, *defs, *capacity * 2 * sizeof(def_t)))
+            return MEMORY_ERR;
+        *defs = error;
+        memset(*defs + *capacity, 0, *capacity * sizeof(def_t));
+        *capacity *= 2;
     }
+    (*defs)[line] = *def;
+    return EXIT_SUCCESS;
+}
 
-    // loop to check if pair has restricted elements
-    for (int i = 0; i < rel->count; i++)
+// Function to check that input has definitions and commands and that there isn't any definition after command
+int CheckLines(string *lines, int lineCount)
+{
+    int commandBegin = 0;
+    int setBegin = 0;
+
+    for (int i = 0; i < lineCount; i++)
     {
-        for (int j = 0; j < PAIR; j++)
+        if (lines[i][0] == COMMAND)
         {
-            if (isRestricted(rel->pair[i].elements[j]))
-            {
-                FreeRelation(rel);
-                return ARGS_ERR;
-            }
+            commandBegin = i;
         }
-    }
-
-    // loop to check if elements from relation exist in universum
-    for (int i = 0; i < rel->count; i++)
-    {
-        for (int j = 0; j < PAIR; j++)
+        else if (lines[i][0] == SET || lines[i][0] == RELATION)
         {
-            if (!isUniversumElement(rel->pair[i].elements[j], universum))
-            {
-                FreeRelation(rel);
+            setBegin = i;
+            if (setBegin > commandBegin && commandBegin)
                 return ARGS_ERR;
-            }
         }
     }
-
-    // frees relation
-    FreeRelation(rel);
-    return errorCode;
+    if (!commandBegin || !setBegin)
+        return ARGS_ERR;
+    return EXIT_SUCCESS;
 }
 
 // Function to execute commands
-int CommandExecution(string *lines, int lineCount)
+int CommandExecution(string *lines, int lineCount, int jobs)
 {
-    exp_t *expression;  // struct to store expression
-    set_t *set1, *set2; // variables of structs to store set1 and set2 (if we have to)
-    set_t *universum;   // struct to store universum
-    rel_t *rel;         // struct to store relation
+    arena_t arena;       // memory for universum and parsed definitions (released at the end)
+    arena_t scratch;     // memory for temporaries of commands
+    output_t output;     // buffered standard output
+    symtab_t *universum; // struct to store universum
+    def_t *defs = NULL;  // parsed definitions and kept results of commands (indexed by line), every line is parsed only once
+    int *firstUse;       // the first command referring to every line (indexed by line, 0 if there is none)
+    int *lastUse;        // the last command referring to every line (kept results are released after it)
+    parsing_t *threads = NULL; // threads which parse definitions (only with more jobs)
+    int first = 0;             // the first line which isn't parsed yet
 
     int errorCode = 0; // error code to specify error by its code
 
     if (lines[0][0] != UNIVERSUM) // checks if the first character of the first line is Universum
         return ARGS_ERR;
-    if (allocate(universum, sizeof(set_t))) // allocates memory for universum
+
+    if (OutputInit(&output, STDOUT_FILENO, OUTPUT_BUFFER))
         return MEMORY_ERR;
-    if ((errorCode = ValidateStringSet(lines[0], NULL))) // validates string for universum
+    ArenaInit(&arena, ARENA_BLOCK);
+    ArenaInit(&scratch, ARENA_BLOCK);
+    context_t ctx = {NULL, &scratch, &output, NULL, StatsCounters(&stats)};
+
+    StatsPhase(&stats, UNIVERSUM_PHASE);
+    if ((universum = ArenaCalloc(&arena, sizeof(symtab_t))) == NULL) // allocates memory for universum
+        errorCode = MEMORY_ERR;
+    else if ((errorCode = ValidateUniversum(lines[0], universum, &arena))) // validates string for universum and interns its elements
+        errorInfo.line = 1;
+    else
     {
-        free(universum);
-        return errorCode;
+        StatsPhase(&stats, DEFINITIONS_PHASE);
+        OutputLine(&output, lines[0]); // prints out universum
+        if (lineCount == 1)
+            errorCode = ARGS_ERR;
+        else if ((defs = ArenaCalloc(&arena, lineCount * sizeof(def_t))) == NULL || (firstUse = ArenaCalloc(&arena, lineCount * sizeof(int))) == NULL ||
+                 (lastUse = ArenaCalloc(&arena, lineCount * sizeof(int))) == NULL)
+            errorCode = MEMORY_ERR;
+        else
+            FindReferences(lines, 0, lineCount, firstUse, lastUse);
     }
-    if ((errorCode = StringToSet(lines[0], universum))) // converts string to set
+    ctx.universum = universum;
+
+    // definitions before the first command are parsed by more threads, the first line with error is parsed again (by the loop below)
+    if (!errorCode && jobs > 1 && (threads = calloc(jobs, sizeof(parsing_t))) != NULL)
     {
-        free(universum);
-        return errorCode;
+        parser_t parser = {lines, 0, universum, defs, 0, 0, PTHREAD_MUTEX_INITIALIZER};
+        while (parser.end < lineCount && lines[parser.end][0] != COMMAND)
+            parser.end++;
+        first = ParallelParsing(&parser, threads, jobs);
+        for (int i = 1; i < first; i++)
+            OutputLine(&output, lines[i]); // prints out the lines before the first error
     }
 
-    printf("%s\n", lines[0]); // prints out universum
+    if (!errorCode)
+        errorCode = ExecuteLines(lines, lineCount, first, defs, firstUse, lastUse, &ctx, &arena, jobs);
+
+    StatsPhase(&stats, OUTPUT_PHASE);
+    OutputFree(&output); // output is written before error message
+    for (int i = 0; defs != NULL && i < lineCount; i++)
+        FreeDefinition(&defs[i]); // kept results of commands have their own memory
+    for (int i = 0; threads != NULL && i < jobs; i++)
+        ArenaFree(&threads[i].arena);
+    free(threads);
+    ArenaFree(&scratch);
+    ArenaFree(&arena); // frees universum and all the definitions at once
+
+    return errorCode;
+}
+// compares times of runs of commands for qsort
+int __compare_times(const void *a, const void *b)
+{
+    uint64_t first = *(const uint64_t *)a, second = *(const uint64_t *)b;
+    return first < second ? -1 : first > second;
+}
 
-    if (lineCount == 1)
+// prints times of one command class (times are sorted), percentiles are nearest ranks
+void __print_times(output_t *out, const command_t *command, int count, const uint64_t *times, size_t runs, bool json)
+{
+    const int percentiles[] = {50, 90, 99};
+    uint64_t sum = 0;
+
+    for (size_t i = 0; i < runs; i++)
+        sum += times[i];
+    OutputString(out, json ? "{\"command\": \"" : "");
+    OutputString(out, command->name);
+    OutputString(out, json ? "\", \"count\": " : ",");
+    OutputNumber(out, count);
+    OutputString(out, json ? ", \"runs\": " : ",");
+    OutputNumber(out, runs);
+    OutputString(out, json ? ", \"min_ns\": " : ",");
+    OutputNumber(out, times[0]);
+    for (int i = 0; i < 3; i++)
     {
-        FreeSet(universum);
-        return ARGS_ERR;
+        OutputString(out, !json ? "," : i == 0 ? ", \"p50_ns\": " : i == 1 ? ", \"p90_ns\": " : ", \"p99_ns\": ");
+        OutputNumber(out, times[(runs * percentiles[i] + 99) / 100 - 1]);
     }
+    OutputString(out, json ? ", \"max_ns\": " : ",");
+    OutputNumber(out, times[runs - 1]);
+    OutputString(out, json ? ", \"mean_ns\": " : ",");
+    OutputNumber(out, sum / runs);
+    OutputString(out, json ? "}" : "\n");
+}
+
+// Function to execute every command reps times (after BENCH_WARMUP runs which aren't measured) and to print times of command
+// classes (like union or closure_trans) as CSV or JSON. Output of commands is thrown away and cache isn't used, kept results
+// of commands are computed again by every run
+int BenchExecution(string *lines, int lineCount, int reps, bool json)
+{
+    arena_t arena;       // memory for universum and parsed definitions
+    arena_t scratch;     // memory for temporaries of commands
+    output_t output;     // output of commands (thrown away)
+    output_t report;     // times of command classes on standard output
+    symtab_t *universum;
+    def_t *defs = NULL;
+    int *firstUse, *lastUse;
+    uint64_t *times = NULL;          // times of measured runs in nanoseconds (reps of every command one after another)
+    const command_t **classes = NULL; // command of every command line (in the order of lines)
+    int commands = 0;                // count of executed command lines
+
+    int errorCode = 0; // error code to specify error by its code
 
-    if (allocate(expression, sizeof(exp_t))) // allocates memory for expression
+    if (lines[0][0] != UNIVERSUM)
+        return ARGS_ERR;
+    int fd = open(NULL_DEVICE, O_WRONLY);
+    if (fd < 0)
+        return FILE_ERR;
+    if (OutputInit(&output, fd, OUTPUT_BUFFER) || OutputInit(&report, STDOUT_FILENO, OUTPUT_BUFFER))
     {
-        FreeSet(universum); // frees the memory
+        close(fd);
         return MEMORY_ERR;
     }
+    ArenaInit(&arena, ARENA_BLOCK);
+    ArenaInit(&scratch, ARENA_BLOCK);
+    context_t ctx = {NULL, &scratch, &output, NULL, StatsCounters(&stats)};
+    cache.lines = 0; // the next runs of command aren't answered from cache
+
+    StatsPhase(&stats, UNIVERSUM_PHASE);
+    if ((universum = ArenaCalloc(&arena, sizeof(symtab_t))) == NULL)
+        errorCode = MEMORY_ERR;
+    else if ((errorCode = ValidateUniversum(lines[0], universum, &arena)))
+        errorInfo.line = 1;
+    else if ((defs = ArenaCalloc(&arena, lineCount * sizeof(def_t))) == NULL || (firstUse = ArenaCalloc(&arena, lineCount * sizeof(int))) == NULL ||
+             (lastUse = ArenaCalloc(&arena, lineCount * sizeof(int))) == NULL || (times = malloc((size_t)lineCount * reps * sizeof(uint64_t))) == NULL ||
+             (classes = malloc(lineCount * sizeof(command_t *))) == NULL)
+        errorCode = MEMORY_ERR;
+    else
+        FindReferences(lines, 0, lineCount, firstUse, lastUse);
+    ctx.universum = universum;
 
-    for (int i = 1; i < lineCount; i++) // goes from the second line till the last one
+    for (int i = 0; !errorCode && i < lineCount; i++)
     {
-        if (lines[i][0] == COMMAND) // if character in a line is C (Command)
+        StatsPhase(&stats, lines[i][0] == COMMAND ? COMMANDS_PHASE : i ? DEFINITIONS_PHASE : UNIVERSUM_PHASE);
+        if (lines[i][0] != COMMAND)
         {
-            if ((errorCode = StringToExpression(lines[i], expression))) // converts this line into expression
-                break;
-            /* from now there is the same algorithm.
-             * 1 - we allocate memory for our sets (if there is more than one) or relation
-             * 2 - convert string into specific structure
-             * 3 - call the function for the specific command
-             *4 - free all the memory we needed
-             */
-
-            if (!strcmp(expression->command, EMPTY))
-            {
-                free(expression->command);
-                if (expression->argumentLength != 1)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
+            if ((errorCode = ParseDefinition(lines[i], i, universum, &defs[i], &arena)))
+                errorInfo.line = i + 1;
+            continue;
+        }
 
-                if (allocate(set1, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
+        string cursor = lines[i] + 1, name;
+        int length = NextElement(&cursor, &name);
+        classes[commands] = FindCommand(name, length);
+        for (int run = -BENCH_WARMUP; !errorCode && run < reps; run++)
+        {
+            struct timespec start, end;
+            FreeDefinition(&defs[i]); // result of the previous run
+            ctx.result = firstUse[i] ? &defs[i] : NULL;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            errorCode = ExecuteCommand(lines[i], defs, i, &ctx);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            if (run >= 0)
+                times[(size_t)commands * reps + run] = (end.tv_sec - start.tv_sec) * 1000000000ull + end.tv_nsec - start.tv_nsec;
+        }
+        commands++;
+        ReleaseResults(lines, i, i + 1, defs, lastUse);
+    }
 
-                if ((errorCode = StringToSet(lines[expression->arguments[0]], set1)))
-                    break;
-                if ((errorCode = Empty(set1)))
-                    break;
-            }
-            else if (!strcmp(expression->command, CARD))
+    StatsPhase(&stats, OUTPUT_PHASE);
+    // times of every class are gathered and sorted (classes are printed in the order of their first commands)
+    bool printed[sizeof(COMMANDS) / sizeof(command_t)] = {false};
+    uint64_t *sorted = NULL; // times of one class
+    if (!errorCode && commands && (sorted = malloc((size_t)commands * reps * sizeof(uint64_t))) == NULL)
+        errorCode = MEMORY_ERR;
+    if (!errorCode)
+        OutputString(&report, json ? "[" : "command,count,runs,min_ns,p50_ns,p90_ns,p99_ns,max_ns,mean_ns\n");
+    for (int i = 0, rows = 0; !errorCode && i < commands; i++)
+    {
+        int count = 0;
+        size_t runs = 0;
+        if (printed[classes[i] - COMMANDS])
+            continue;
+        printed[classes[i] - COMMANDS] = true;
+        for (int j = i; j < commands; j++)
+            if (classes[j] == classes[i])
             {
-                free(expression->command);
-                if (expression->argumentLength != 1)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
-
-                if (allocate(set1, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
-                if ((errorCode = StringToSet(lines[expression->arguments[0]], set1)))
-                    break;
-                if ((errorCode = Card(set1)))
-                    break;
+                memcpy(sorted + runs, times + (size_t)j * reps, reps * sizeof(uint64_t));
+                runs += reps;
+                count++;
             }
-            else if (!strcmp(expression->command, COMPLEMENT))
-            {
-                free(expression->command);
-                if (expression->argumentLength != 1)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
-
-                if (allocate(set1, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
-                if ((errorCode = StringToSet(lines[expression->arguments[0]], set1)))
-                    break;
-                if ((errorCode = Complement(universum, set1)))
-                    break;
-            }
-            else if (!strcmp(expression->command, UNION))
-            {
-                free(expression->command);
-                if (expression->argumentLength != 2)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
-
-                if (allocate(set1, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
-                if (allocate(set2, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
-
-                if ((errorCode = StringToSet(lines[expression->arguments[0]], set1)))
-                {
-                    free(set2);
-                    break;
-                }
-                if (((errorCode = StringToSet(lines[expression->arguments[1]], set2))))
-                {
-                    FreeSet(set1);
-                    break;
-                }
-
-                if ((errorCode = Union(set1, set2)))
-                    break;
-            }
-            else if (!strcmp(expression->command, INTERSECT))
-            {
-                free(expression->command);
-                if (expression->argumentLength != 2)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
-
-                if (allocate(set1, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
-                if (allocate(set2, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
-
-                if ((errorCode = StringToSet(lines[expression->arguments[0]], set1)))
-                {
-                    free(set2);
-                    break;
-                }
-                if (((errorCode = StringToSet(lines[expression->arguments[1]], set2))))
-                {
-                    FreeSet(set1);
-                    break;
-                }
-
-                if ((errorCode = Intersect(set1, set2)))
-                    break;
-            }
-            else if (!strcmp(expression->command, MINUS))
-            {
-                free(expression->command);
-                if (expression->argumentLength != 2)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
-
-                if (allocate(set1, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
-                if (allocate(set2, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
-
-                if ((errorCode = StringToSet(lines[expression->arguments[0]], set1)))
-                {
-                    free(set2);
-                    break;
-                }
-                if (((errorCode = StringToSet(lines[expression->arguments[1]], set2))))
-                {
-                    FreeSet(set1);
-                    break;
-                }
+        qsort(sorted, runs, sizeof(uint64_t), __compare_times);
+        if (json)
+            OutputString(&report, rows++ ? ",\n  " : "\n  ");
+        __print_times(&report, classes[i], count, sorted, runs, json);
+    }
+    if (!errorCode && json)
+        OutputString(&report, "\n]\n");
+    free(sorted);
+
+    OutputFree(&output);
+    OutputFree(&report);
+    close(fd);
+    for (int i = 0; defs != NULL && i < lineCount; i++)
+        FreeDefinition(&defs[i]);
+    free(times);
+    free(classes);
+    ArenaFree(&scratch);
+    ArenaFree(&arena);
+    return errorCode;
+}
 
-                if ((errorCode = Minus(set1, set2)))
-                    break;
-            }
-            else if (!strcmp(expression->command, SUBSETEQ))
-            {
-                free(expression->command);
-                if (expression->argumentLength != 2)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
+// random numbers (xorshift64*), state can't be 0
+uint64_t __random(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ull;
+}
 
-                if (allocate(set1, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
-                if (allocate(set2, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
+// writes name of generated element after prefix: q and digits of ID in base 52 (restricted words don't start with q)
+void __gen_element(output_t *out, const char *prefix, uint64_t id)
+{
+    static const char letters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    OutputString(out, prefix);
+    OutputChar(out, 'q');
+    do
+        OutputChar(out, letters[id % 52]);
+    while ((id /= 52));
+}
 
-                if ((errorCode = StringToSet(lines[expression->arguments[0]], set1)))
-                    break;
-                if ((errorCode = StringToSet(lines[expression->arguments[1]], set2)))
-                    break;
+// writes generated pair with space before it
+void __gen_pair(output_t *out, uint64_t a, uint64_t b)
+{
+    __gen_element(out, " (", a);
+    __gen_element(out, " ", b);
+    OutputChar(out, ')');
+}
 
-                if ((errorCode = Subseteq(set1, set2)))
-                    break;
-            }
-            else if (!strcmp(expression->command, SUBSET))
-            {
-                free(expression->command);
-                if (expression->argumentLength != 2)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
+// parses spec of generated input like "universe=1000,density=0.1,shape=chain" (unknown key or wrong value is ARGS_ERR)
+int __gen_spec(string spec, gen_t *dest)
+{
+    for (string key = spec, next; *key; key = next)
+    {
+        string value = strchr(key, '='), end;
+        if ((next = strchr(key, ',')) == NULL)
+            next = key + strlen(key);
+        else
+            *next++ = '\0';
+        if (value == NULL || value > next)
+            return ARGS_ERR;
+        *value++ = '\0';
+
+        errno = 0;
+        unsigned long long number = strtoull(value, &end, 10);
+        double density;
+        bool numeric = *value >= '0' && *value <= '9' && !*end && !errno;
+        if (!strcmp(key, "universe") && numeric && number < NOT_FOUND)
+            dest->universe = number;
+        else if (!strcmp(key, "sets") && numeric && number <= INT_MAX)
+            dest->sets = number;
+        else if (!strcmp(key, "density") && *value && (density = strtod(value, &end)) >= 0 && density <= 1 && !*end)
+            dest->density = density;
+        else if (!strcmp(key, "relations") && numeric && number <= INT_MAX)
+            dest->relations = number;
+        else if (!strcmp(key, "pairs") && numeric)
+            dest->pairs = number;
+        else if (!strcmp(key, "shape") && (!strcmp(value, "random") || !strcmp(value, "chain") || !strcmp(value, "complete") ||
+                                           !strcmp(value, "functional") || !strcmp(value, "bijective")))
+            dest->shape = value;
+        else if (!strcmp(key, "commands") && numeric && number <= INT_MAX)
+            dest->commands = number;
+        else if (!strcmp(key, "mix") && *value)
+            dest->mix = value;
+        else if (!strcmp(key, "seed") && numeric)
+            dest->seed = number;
+        else
+            return ARGS_ERR;
+    }
+    return EXIT_SUCCESS;
+}
 
-                if (allocate(set1, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
-                if (allocate(set2, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
+// checks if command is in mix of generated commands (all, sets, relations or names joined by +)
+bool __gen_command(const command_t *command, gen_t *gen)
+{
+    bool relation = strchr(command->kinds, RELATION) != NULL;
+    size_t length = strlen(command->name);
+
+    if (relation && !gen->relations)
+        return false;
+    if (!strcmp(gen->mix, "all") || !strcmp(gen->mix, relation ? "relations" : "sets"))
+        return true;
+    for (string name = gen->mix; (name = strstr(name, command->name)) != NULL; name++)
+        if ((name == gen->mix || name[-1] == '+') && (name[length] == '+' || !name[length]))
+            return true;
+    return false;
+}
 
-                if ((errorCode = StringToSet(lines[expression->arguments[0]], set1)))
-                    break;
-                if ((errorCode = StringToSet(lines[expression->arguments[1]], set2)))
-                    break;
+// writes generated relation, pairs are unique (random pairs are checked by hash table)
+int __gen_relation(output_t *out, gen_t *gen, uint64_t *state)
+{
+    uint64_t n = gen->universe, pairs = gen->pairs ? gen->pairs : n;
 
-                if ((errorCode = Subset(set1, set2)))
-                    break;
-            }
-            else if (!strcmp(expression->command, EQUALS))
-            {
-                free(expression->command);
-                if (expression->argumentLength != 2)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
+    OutputChar(out, RELATION);
+    if (!n)
+        return EXIT_SUCCESS;
+    if (!strcmp(gen->shape, "random"))
+    {
+        uint64_t *slots, mask = 1; // hash table of pairs (a * n + b + 1, 0 is empty slot)
+        if (pairs > n * n / 2) // pairs are found by random tries
+            pairs = n * n / 2;
+        while (mask < 2 * pairs)
+            mask *= 2;
+        if ((slots = calloc(mask--, sizeof(uint64_t))) == NULL)
+            return MEMORY_ERR;
+        for (uint64_t i = 0; i < pairs;)
+        {
+            uint64_t a = __random(state) % n, b = __random(state) % n, key = a * n + b + 1, slot = key * 0x9E3779B97F4A7C15ull >> 20 & mask;
+            while (slots[slot] && slots[slot] != key)
+                slot = (slot + 1) & mask;
+            if (slots[slot])
+                continue;
+            slots[slot] = key;
+            __gen_pair(out, a, b);
+            i++;
+        }
+        free(slots);
+    }
+    else if (!strcmp(gen->shape, "chain")) // a1 -> a2 -> a3 ...
+        for (uint64_t i = 0; i < pairs && i + 1 < n; i++)
+            __gen_pair(out, i, i + 1);
+    else if (!strcmp(gen->shape, "complete")) // all the pairs of the first k elements (k * k is at least count of pairs)
+    {
+        uint64_t k = 1;
+        while (k < n && k * k < pairs)
+            k++;
+        for (uint64_t i = 0; i < pairs && i < k * k; i++)
+            __gen_pair(out, i / k, i % k);
+    }
+    else if (!strcmp(gen->shape, "functional")) // every element has one random image
+        for (uint64_t i = 0; i < pairs && i < n; i++)
+            __gen_pair(out, i, __random(state) % n);
+    else // bijective: random permutation of the first elements
+    {
+        uint32_t *images;
+        if (pairs > n)
+            pairs = n;
+        if ((images = malloc(pairs * sizeof(uint32_t))) == NULL)
+            return MEMORY_ERR;
+        for (uint64_t i = 0; i < pairs; i++)
+        {
+            uint64_t j = __random(state) % (i + 1); // Fisher-Yates shuffle
+            images[i] = images[j];
+            images[j] = i;
+        }
+        for (uint64_t i = 0; i < pairs; i++)
+            __gen_pair(out, i, images[i]);
+        free(images);
+    }
+    return EXIT_SUCCESS;
+}
 
-                if (allocate(set1, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
-                if (allocate(set2, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
+// Function to write random input to standard output: universum, sets, relations and commands (commands of mix are used in turn,
+// their arguments are random lines of the right kind). Universum is the 1st line, so commands always have some set
+int GenerateInput(string spec)
+{
+    gen_t gen = {1000, 8, 0.5, 4, 0, "random", 1000, "all", 1};
+    const command_t *mix[sizeof(COMMANDS) / sizeof(command_t)]; // commands which are generated
+    int count = 0;
+    output_t output;
+    uint64_t state;
 
-                if ((errorCode = StringToSet(lines[expression->arguments[0]], set1)))
-                    break;
-                if ((errorCode = StringToSet(lines[expression->arguments[1]], set2)))
-                    break;
+    int errorCode = 0; // error code to specify error by its code
 
-                if ((errorCode = Equals(set1, set2)))
-                    break;
-            }
-            else if (!strcmp(expression->command, REFLEXIVE))
-            {
-                free(expression->command);
-                if (expression->argumentLength != 1)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
+    if ((errorCode = __gen_spec(spec, &gen)))
+        return errorCode;
+    for (size_t i = 0; i < sizeof(COMMANDS) / sizeof(command_t); i++)
+        if (COMMANDS[i].kinds != NULL && __gen_command(&COMMANDS[i], &gen))
+            mix[count++] = &COMMANDS[i];
+    if (!count && gen.commands) // mix has only unknown commands (or commands with relations, but there is none)
+        return ARGS_ERR;
+    if (OutputInit(&output, STDOUT_FILENO, OUTPUT_BUFFER))
+        return MEMORY_ERR;
+    state = gen.seed * 0x9E3779B97F4A7C15ull + 1;
 
-                if (allocate(rel, sizeof(rel_t)))
-                    return MEMORY_ERR;
-                if ((errorCode = StringToRelation(lines[expression->arguments[0]], rel)))
-                    break;
-                if ((errorCode = Reflexive(rel, universum)))
-                    break;
-            }
-            else if (!strcmp(expression->command, SYMMETRIC))
-            {
-                free(expression->command);
-                if (expression->argumentLength != 1)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
+    OutputChar(&output, UNIVERSUM);
+    for (uint32_t i = 0; i < gen.universe; i++)
+        __gen_element(&output, " ", i);
+    for (int s = 0; s < gen.sets; s++)
+    {
+        OutputString(&output, "\nS");
+        for (uint32_t i = 0; i < gen.universe; i++)
+            if ((__random(&state) >> 11) * 0x1.0p-53 < gen.density)
+                __gen_element(&output, " ", i);
+    }
+    for (int r = 0; !errorCode && r < gen.relations; r++)
+    {
+        OutputChar(&output, '\n');
+        errorCode = __gen_relation(&output, &gen, &state);
+    }
 
-                if (allocate(rel, sizeof(rel_t)))
-                    return MEMORY_ERR;
-                if ((errorCode = StringToRelation(lines[expression->arguments[0]], rel)))
-                    break;
-                if ((errorCode = Symmetric(rel)))
-                    break;
-            }
-            else if (!strcmp(expression->command, ANTISYMMETRIC))
-            {
-                free(expression->command);
-                if (expression->argumentLength != 1)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
-                if (allocate(rel, sizeof(rel_t)))
-                    return MEMORY_ERR;
-                if ((errorCode = StringToRelation(lines[expression->arguments[0]], rel)))
-                    break;
-                if ((errorCode = Antisymmetric(rel)))
-                    break;
-            }
-            else if (!strcmp(expression->command, TRANSITIVE))
-            {
-                free(expression->command);
-                if (expression->argumentLength != 1)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
-                if (allocate(rel, sizeof(rel_t)))
-                    return MEMORY_ERR;
-                if ((errorCode = StringToRelation(lines[expression->arguments[0]], rel)))
-                    break;
-                if ((errorCode = Transitive(rel)))
-                    break;
-            }
-            else if (!strcmp(expression->command, FUNCTION))
-            {
-                free(expression->command);
-                if (expression->argumentLength != 1)
+    // lines of sets are 1..sets+1 (universum is the first one), relations are after them
+    for (int c = 0; !errorCode && c < gen.commands; c++)
+    {
+        const command_t *command = mix[c % count];
+        OutputString(&output, "\nC ");
+        OutputString(&output, command->name);
+        for (string kind = command->kinds; *kind; kind++)
+        {
+            OutputChar(&output, ' ');
+            if (*kind == RELATION)
+                OutputNumber(&output, gen.sets + 2 + __random(&state) % gen.relations);
+            else if (*kind == SET)
+                OutputNumber(&output, 1 + __random(&state) % (gen.sets + 1));
+            else // expression with 2 - 4 operands
+                for (int operands = 2 + __random(&state) % 3, i = 0; i < operands; i++)
                 {
-                    errorCode = ARGS_ERR;
-                    break;
+                    static const string operators[] = {" & ", " | ", " - "};
+                    if (i)
+                        OutputString(&output, operators[__random(&state) % 3]);
+                    if (!(__random(&state) % 4))
+                        OutputChar(&output, '~');
+                    OutputNumber(&output, 1 + __random(&state) % (gen.sets + 1));
                 }
+        }
+    }
+    OutputChar(&output, '\n');
+    OutputFree(&output);
+    return errorCode;
+}
 
-                if (allocate(rel, sizeof(rel_t)))
-                    return MEMORY_ERR;
-                if ((errorCode = StringToRelation(lines[expression->arguments[0]], rel)))
-                    break;
-                if ((errorCode = Function(rel)))
-                    break;
-            }
-            else if (!strcmp(expression->command, DOMAIN))
-            {
-                free(expression->command);
-                if (expression->argumentLength != 1)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
-                if (allocate(rel, sizeof(rel_t)))
-                    return MEMORY_ERR;
-                if ((errorCode = StringToRelation(lines[expression->arguments[0]], rel)))
-                    break;
-                if ((errorCode = Domain(rel)))
-                    break;
-            }
-            else if (!strcmp(expression->command, CODOMAIN))
-            {
-                free(expression->command);
-                if (expression->argumentLength != 1)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
-                if (allocate(rel, sizeof(rel_t)))
-                    return MEMORY_ERR;
-                if ((errorCode = StringToRelation(lines[expression->arguments[0]], rel)))
-                    break;
-                if ((errorCode = Codomain(rel)))
-                    break;
-            }
-            else if (!strcmp(expression->command, INJECTIVE))
-            {
-                // printf("\t%d %d %d\n", expression->arguments[0], expression->arguments[1], expression->arguments[2]);
+// Function to execute lines begin..lineCount-1 (lines before begin are already parsed), lines are printed out as they are and commands by their output
+int ExecuteLines(string *lines, int lineCount, int begin, def_t *defs, int *firstUse, int *lastUse, context_t *ctx, arena_t *arena, int jobs)
+{
+    int errorCode = 0; // error code to specify error by its code
 
-                free(expression->command);
-                if (expression->argumentLength != 3)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
-                if (allocate(rel, sizeof(rel_t)))
-                    return MEMORY_ERR;
-                if (allocate(set1, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
-                if (allocate(set2, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
-                if ((errorCode = StringToRelation(lines[expression->arguments[0]], rel))) // 2
-                    break;
-                if ((errorCode = StringToSet(lines[expression->arguments[1]], set1))) // 3
-                    break;
-                if ((errorCode = StringToSet(lines[expression->arguments[2]], set2))) // 5
-                    break;
-                if ((errorCode = Injective(rel, set1, set2)))
-                    break;
-            }
-            else if (!strcmp(expression->command, SURJECTIVE))
-            {
-                free(expression->command);
-                if (expression->argumentLength != 3)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
-                if (allocate(rel, sizeof(rel_t)))
-                    return MEMORY_ERR;
-                if (allocate(set1, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
-                if (allocate(set2, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
-                if ((errorCode = StringToRelation(lines[expression->arguments[0]], rel)))
-                    break;
-                if ((errorCode = StringToSet(lines[expression->arguments[1]], set1)))
-                    break;
-                if ((errorCode = StringToSet(lines[expression->arguments[2]], set2)))
-                    break;
-                if ((errorCode = Surjective(rel, set1, set2)))
-                    break;
-            }
-            else if (!strcmp(expression->command, BIJECTIVE))
-            {
-                free(expression->command);
-                if (expression->argumentLength != 3)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
-                if (allocate(rel, sizeof(rel_t)))
-                    return MEMORY_ERR;
-                if (allocate(set1, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
-                if (allocate(set2, sizeof(set_t)))
-                    errorCode = MEMORY_ERR;
-                if ((errorCode = StringToRelation(lines[expression->arguments[0]], rel)))
-                    break;
-                if ((errorCode = StringToSet(lines[expression->arguments[1]], set1)))
-                    break;
-                if ((errorCode = StringToSet(lines[expression->arguments[2]], set2)))
-                    break;
-                if ((errorCode = Bijective(rel, set1, set2)))
-                    break;
-            }
-            else
-            {
-                errorCode = ARGS_ERR;
+    for (int i = begin; !errorCode && i < lineCount; i++) // goes from the first line till the last one
+    {
+        StatsPhase(&stats, lines[i][0] == COMMAND ? COMMANDS_PHASE : i ? DEFINITIONS_PHASE : UNIVERSUM_PHASE);
+        if (lines[i][0] == COMMAND && jobs > 1) // commands till the next definition are executed by more threads
+        {
+            // the run of commands ends before command which refers to result of some command of the run
+            int end = i, next = lineCount;
+            for (; end < lineCount && lines[end][0] == COMMAND && end != next; end++)
+                if (firstUse[end] && firstUse[end] < next)
+                    next = firstUse[end];
+            errorCode = ParallelExecution(lines, lineCount, i, end, defs, firstUse, ctx, jobs);
+            ReleaseResults(lines, i, end, defs, lastUse);
+            i = end - 1;
+        }
+        else if (lines[i][0] == COMMAND) // if character in a line is C (Command)
+        {
+            ctx->result = firstUse[i] ? &defs[i] : NULL; // result is kept only if some of the next commands refers to it
+            if ((errorCode = ExecuteCommand(lines[i], defs, i, ctx))) // executes command from this line
                 break;
-            }
+            ReleaseResults(lines, i, i + 1, defs, lastUse);
             if (i + 1 != lineCount)
-                printf("\n");
+                OutputChar(ctx->out, '\n');
         }
         else
         {
-            switch (lines[i][0]) // if the character is not C
+            if ((errorCode = ParseDefinition(lines[i], i, ctx->universum, &defs[i], arena))) // validates and parses the line
             {
-            case SET:                                               // if its S
-                errorCode = ValidateStringSet(lines[i], universum); // validates string of set
-                break;
-            case RELATION:                                               // if its R
-                errorCode = ValidateStringRelation(lines[i], universum); // validates string of relation
-                break;
-            default: // if this is something else
-                errorCode = ARGS_ERR;
+                errorInfo.line = i + 1;
                 break;
             }
-            if (errorCode)
-                break;
+            if (i) // universum is already printed
+                OutputLine(ctx->out, lines[i]); // prints out the line if there was no error
+        }
+    }
+    return errorCode;
+}
+
+// Function to find the first and the last command referring to every line from begin (index of that command, it stays 0 if there is none)
+void FindReferences(string *lines, int begin, int lineCount, int *firstUse, int *lastUse)
+{
+    exp_t expression;
+
+    for (int i = begin; i < lineCount; i++)
+    {
+        if (lines[i][0] != COMMAND || StringToExpression(lines[i], &expression)) // syntax errors are found when the command is executed
+            continue;
+        for (int j = 0; j < expression.argumentLength; j++)
+        {
+            int line = expression.arguments[j];
+            if (line >= begin && line < i && !firstUse[line])
+                firstUse[line] = i;
+            if (line >= begin && line < i)
+                lastUse[line] = i;
+        }
+    }
+}
+
+// Function to free kept results of commands which commands begin..end-1 referred to as the last ones (definitions stay in memory of run)
+void ReleaseResults(string *lines, int begin, int end, def_t *defs, int *lastUse)
+{
+    exp_t expression;
 
-            printf("%s\n", lines[i]); // prints out the line if there was no error
+    for (int i = begin; i < end; i++)
+    {
+        if (StringToExpression(lines[i], &expression))
+            continue;
+        for (int j = 0; j < expression.argumentLength; j++)
+        {
+            int line = expression.arguments[j];
+            if (line >= 0 && line < i && lastUse[line] == i && lines[line][0] == COMMAND)
+                FreeDefinition(&defs[line]);
         }
     }
+}
+
+// Function to find the last command referring to every line (lastUse[line] is index of that command, 0 if there is none)
+int CountReferences(stream_t *stream, int **lastUse, int *lineCount)
+{
+    int commandBegin = 0;
+    int setBegin = 0;
+    int capacity = 64;
+    string line;
+    void *error;
+    exp_t expression;
+
+    int errorCode = 0;
+
+    reset(*lineCount);
+    if ((*lastUse = calloc(capacity, sizeof(int))) == NULL)
+        return MEMORY_ERR;
+
+    for (int i = 0; !(errorCode = ReadLine(stream, &line)) && line != NULL; i++)
+    {
+        if (i == capacity) // array is resized twice
+        {
+            if (reallocate(error, *lastUse, capacity * 2 * sizeof(int)))
+                return MEMORY_ERR;
+            *lastUse = error;
+            memset(*lastUse + capacity, 0, capacity * sizeof(int));
+            capacity *= 2;
+        }
+        *lineCount = i + 1;
 
-    free(expression);
-    FreeSet(universum);
+        if (line[0] == COMMAND)
+        {
+            commandBegin = i;
+            if (StringToExpression(line, &expression)) // syntax errors are found when the command is executed
+                continue;
+            for (int j = 0; j < expression.argumentLength; j++) // definitions and results of previous commands
+                if (expression.arguments[j] >= 0 && expression.arguments[j] < i)
+                    (*lastUse)[expression.arguments[j]] = i;
+        }
+        else if (line[0] == SET || line[0] == RELATION)
+        {
+            setBegin = i;
+            if (commandBegin) // definition after command
+                return ARGS_ERR;
+        }
+    }
 
+    if (!errorCode && (!commandBegin || !setBegin))
+        errorCode = ARGS_ERR;
     return errorCode;
 }
+
+// moves kept result of command into arena with one block of the size of result (arena of command grows twice and it keeps
+// buffers which were resized), returns MEMORY_ERR if result can't be moved
+int __compact_result(def_t *result)
+{
+    const set_t *set = result->set;
+    const rel_t *rel = result->rel;
+    uint64_t words = 0; // words of containers of set (they are one after another)
+    arena_t arena;
+
+    if (set != NULL && set->size)
+        words = set->containers[set->size - 1].offset + ContainerWords(set->containers[set->size - 1].type, set->containers[set->size - 1].size);
+    ArenaInit(&arena, set != NULL ? sizeof(set_t) + set->size * sizeof(container_t) + words * sizeof(uint64_t) : sizeof(rel_t) + rel->count * sizeof(pair_t));
+
+    if (set != NULL)
+    {
+        set_t *copy;
+        if ((copy = ArenaAlloc(&arena, sizeof(set_t))) == NULL || (copy->containers = ArenaAlloc(&arena, set->size * sizeof(container_t))) == NULL ||
+            (copy->data = ArenaAlloc(&arena, words * sizeof(uint64_t))) == NULL)
+        {
+            ArenaFree(&arena);
+            return MEMORY_ERR;
+        }
+        copy->size = set->size;
+        copy->count = set->count;
+        memcpy(copy->containers, set->containers, set->size * sizeof(container_t));
+        memcpy(copy->data, set->data, words * sizeof(uint64_t));
+        ArenaFree(&result->arena);
+        result->set = copy;
+    }
+    else
+    {
+        rel_t *copy;
+        if ((copy = ArenaAlloc(&arena, sizeof(rel_t))) == NULL || (copy->pair = ArenaAlloc(&arena, rel->count * sizeof(pair_t))) == NULL)
+        {
+            ArenaFree(&arena);
+            return MEMORY_ERR;
+        }
+        copy->count = rel->count;
+        memcpy(copy->pair, rel->pair, rel->count * sizeof(pair_t));
+        ArenaFree(&result->arena);
+        result->rel = copy;
+    }
+    result->arena = arena;
+    return EXIT_SUCCESS;
+}
+
+// executes again commands whose results this command refers to and keeps their results (pipe is read once, so results of commands
+// aren't kept until some command refers to them). Their arguments are already kept, they were executed again before these commands
+int __execute_again(string line, int lineIndex, def_t *defs, int capacity, context_t *ctx, output_t *discard)
+{
+    exp_t expression;
+    output_t *out = ctx->out;
+    def_t result;
+
+    int errorCode = 0; // error code to specify error by its code
+
+    if (StringToExpression(line, &expression)) // syntax errors are found when the command is executed
+        return EXIT_SUCCESS;
+    ctx->out = discard;
+    for (int j = 0; !errorCode && j < expression.argumentLength; j++)
+    {
+        int argument = expression.arguments[j];
+        if (argument < 0 || argument >= lineIndex || argument >= capacity || defs[argument].source == NULL ||
+            defs[argument].set != NULL || defs[argument].rel != NULL)
+            continue;
+
+        memset(&result, 0, sizeof(def_t));
+        ctx->result = &result;
+        errorCode = ExecuteCommand(defs[argument].source, defs, argument, ctx);
+        discard->size = 0;
+        if (!errorCode && (result.set != NULL || result.rel != NULL)) // result is kept till the end (pipe can't be read again)
+            errorCode = __compact_result(&result);
+        if (errorCode || (result.set == NULL && result.rel == NULL)) // result isn't set or relation (command refers to it by mistake)
+            FreeDefinition(&result);
+        else
+            result.source = defs[argument].source;
+        defs[argument] = result;
+    }
+    ctx->out = out;
+    ctx->result = NULL;
+    return errorCode;
+}
+
+// Function to execute commands while the input is being read.
+// Only definitions and results of commands which some of the next commands refer to are kept in memory (already parsed),
+// pipe is read once, so only commands are kept and their results are computed again when some command refers to them
+int StreamExecution(string path)
+{
+    stream_t stream;            // input read line by line
+    arena_t arena;              // memory for universum
+    arena_t scratch;            // memory for temporaries of commands and for definitions which are not kept
+    output_t output;            // buffered standard output
+    output_t discard;           // output of commands executed again (thrown away)
+    symtab_t *universum = NULL; // struct to store universum
+    string line;                // current line
+    def_t *defs;                // parsed definitions and results which commands can still refer to (indexed by line)
+    def_t def;                  // currently parsed definition (or result of command)
+    int *lastUse = NULL;        // index of the last command referring to line (indexed by line)
+    int defCount = 0;           // count of lines before the first command
+    int capacity = 64;          // size of defs
+    exp_t expression;           // current command (to find lines which it refers to as the last one)
+    bool known = false;         // true if lastUse was counted before execution (input can be read twice)
+    bool newline = false;       // true if new line has to be printed before the next line
+    int setBegin = 0;
+
+    int errorCode = 0; // error code to specify error by its code
+
+    if ((errorCode = OpenStream(path, &stream)))
+        return errorCode;
+
+    // regular files are read twice, the first pass only finds the last command referring to every definition
+    struct stat info;
+    if (!fstat(stream.fd, &info) && S_ISREG(info.st_mode))
+    {
+        known = true;
+        if ((errorCode = CountReferences(&stream, &lastUse, &capacity)) || lseek(stream.fd, 0, SEEK_SET))
+        {
+            free(lastUse);
+            CloseStream(&stream);
+            return errorCode ? errorCode : FILE_ERR;
+        }
+        reset(stream.begin);
+        reset(stream.end);
+        stream.eof = false;
+    }
+
+    output.data = discard.data = NULL;
+    if ((defs = calloc(capacity, sizeof(def_t))) == NULL || OutputInit(&output, STDOUT_FILENO, OUTPUT_BUFFER) ||
+        (!known && OutputInit(&discard, -1, RESULT_BUFFER)))
+    {
+        free(output.data);
+        free(defs);
+        free(lastUse);
+        CloseStream(&stream);
+        return MEMORY_ERR;
+    }
+
+    ArenaInit(&arena, ARENA_BLOCK);
+    ArenaInit(&scratch, ARENA_BLOCK);
+    context_t ctx = {NULL, &scratch, &output, NULL, StatsCounters(&stats)};
+
+    // reading of the next line is measured as load
+    for (int i = 0; !errorCode && (StatsPhase(&stats, LOAD_PHASE), !(errorCode = ReadLine(&stream, &line))) && line != NULL; i++)
+    {
+        StatsPhase(&stats, line[0] == COMMAND ? COMMANDS_PHASE : i ? DEFINITIONS_PHASE : UNIVERSUM_PHASE);
+        if (newline) // new line is printed only if there is the next line
+            OutputChar(&output, '\n');
+        newline = false;
+
+        if (i == 0)
+        {
+            if ((universum = ArenaCalloc(&arena, sizeof(symtab_t))) == NULL) // allocates memory for universum
+                errorCode = MEMORY_ERR;
+            else
+                errorCode = ValidateUniversum(line, universum, &arena); // validates string for universum and interns its elements
+            if (errorCode)
+            {
+                errorInfo.line = 1;
+                break;
+            }
+            ctx.universum = universum;
+        }
+        else if (line[0] == COMMAND) // if character in a line is C (Command)
+        {
+            if (!defCount) // the first command
+                defCount = i;
+
+            // results which this command refers to are computed again (on pipe)
+            if (!known && (errorCode = __execute_again(line, i, defs, capacity, &ctx, &discard)))
+                break;
+
+            // result gets its own memory if some of the next commands refers to it
+            memset(&def, 0, sizeof(def_t));
+            ctx.result = known && lastUse[i] ? &def : NULL;
+            if ((errorCode = ExecuteCommand(line, defs, i < capacity ? i : capacity, &ctx))) // executes command from this line
+            {
+                FreeDefinition(&def);
+                break;
+            }
+            newline = true;
+
+            // releases lines which this command referred to as the last one
+            if (known && !StringToExpression(line, &expression))
+                for (int j = 0; j < expression.argumentLength; j++)
+                {
+                    int argument = expression.arguments[j];
+                    if (argument >= 0 && argument < i && lastUse[argument] == i)
+                        FreeDefinition(&defs[argument]);
+                }
+
+            if (!known && (def.source = ArenaAlloc(&arena, strlen(line) + 1)) != NULL) // on pipe, only command is kept
+                strcpy(def.source, line);
+            else if (!known)
+                errorCode = MEMORY_ERR;
+
+            if (errorCode || (def.set == NULL && def.rel == NULL && def.source == NULL)) // result isn't set or relation (or no command refers to it)
+                FreeDefinition(&def);
+            else if ((errorCode = KeepDefinition(&defs, &capacity, i, &def)))
+                FreeDefinition(&def);
+            continue;
+        }
+        else if (defCount && !known && i > defCount) // definition after command
+            errorCode = ARGS_ERR;
+        else
+            setBegin = i;
+
+        if (errorCode)
+            break;
+
+        // definition which some of the next commands refer to gets its own memory, so it can be released on its own
+        if (known && !lastUse[i])
+        {
+            ArenaReset(&scratch);
+            errorCode = ParseDefinition(line, i, universum, &def, &scratch); // validates the line only
+        }
+        else
+        {
+            ArenaInit(&def.arena, 2 * strlen(line) + 128);
+            if ((errorCode = ParseDefinition(line, i, universum, &def, &def.arena))) // validates and parses the line
+                FreeDefinition(&def);
+        }
+        if (errorCode)
+        {
+            errorInfo.line = i + 1;
+            break;
+        }
+
+        OutputLine(&output, line); // prints out the line if there was no error
+
+        if (known && !lastUse[i]) // no command refers to this definition
+            continue;
+        if ((errorCode = KeepDefinition(&defs, &capacity, i, &def)))
+            FreeDefinition(&def);
+    }
+
+    // input without commands or without definitions
+    if (!errorCode && (!defCount || !setBegin))
+        errorCode = ARGS_ERR;
+
+    StatsPhase(&stats, OUTPUT_PHASE);
+    for (int i = 0; defs != NULL && i < capacity; i++)
+        FreeDefinition(&defs[i]);
+    free(defs);
+    free(lastUse);
+    free(discard.data);
+    OutputFree(&output); // output is written before error message
+    ArenaFree(&scratch);
+    ArenaFree(&arena);
+    CloseStream(&stream);
+
+    return errorCode;
+}
+
+// resizes arrays indexed by lines, so lineCount lines fit into them (new definitions are empty)
+int __reserve_lines(server_t *server, int lineCount)
+{
+    void *error;
+
+    if (lineCount <= server->capacity)
+        return EXIT_SUCCESS;
+    int capacity = server->capacity * 2 > lineCount ? server->capacity * 2 : lineCount;
+
+    if (reallocate(error, server->input.lines, capacity * sizeof(string)))
+        return MEMORY_ERR;
+    server->input.lines = error;
+    if (reallocate(error, server->defs, capacity * sizeof(def_t)))
+        return MEMORY_ERR;
+    server->defs = error;
+    memset(server->defs + server->capacity, 0, (capacity - server->capacity) * sizeof(def_t));
+    if (reallocate(error, server->firstUse, capacity * sizeof(int)))
+        return MEMORY_ERR;
+    server->firstUse = error;
+    if (reallocate(error, server->lastUse, capacity * sizeof(int)))
+        return MEMORY_ERR;
+    server->lastUse = error;
+
+    server->capacity = capacity;
+    return EXIT_SUCCESS;
+}
+
+// Function to load definitions once and to answer batches of commands sent by clients over Unix domain socket (one batch after another).
+// Definitions are read from file or from snapshot. Commands of batch are numbered like lines appended to the definitions,
+// their output ends by '\0' and error code (with details of error)
+int ServeExecution(string path, string address, string snapshot, int jobs)
+{
+    server_t server = {.jobs = jobs};
+    struct sockaddr_un name = {.sun_family = AF_UNIX};
+    struct sigaction action = {.sa_handler = StopServer}; // accept is interrupted by signal (without SA_RESTART)
+    struct stat info;
+    int listener = -1;  // socket which accepts clients
+    bool bound = false; // true if socket file was created by this server
+
+    int errorCode = 0; // error code to specify error by its code
+
+    if (strlen(address) >= sizeof(name.sun_path))
+        return ARGS_ERR;
+    strcpy(name.sun_path, address);
+    errorCode = snapshot != NULL ? LoadSnapshot(&server, snapshot) : LoadDefinitions(&server, path);
+
+    // socket of stopped server is replaced (if nobody accepts connections on it)
+    if (!errorCode && !lstat(address, &info) && S_ISSOCK(info.st_mode))
+    {
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (probe >= 0 && !connect(probe, (struct sockaddr *)&name, sizeof(name))) // other server is running
+            errorCode = FILE_ERR;
+        else
+            unlink(address);
+        if (probe >= 0)
+            close(probe);
+    }
+    if (!errorCode && ((listener = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 || !(bound = !bind(listener, (struct sockaddr *)&name, sizeof(name))) ||
+                       listen(listener, SOMAXCONN)))
+        errorCode = FILE_ERR;
+
+    if (!errorCode)
+    {
+        cache.lines = server.count; // lines of batches are different in every batch
+        signal(SIGPIPE, SIG_IGN);   // client which doesn't read its output is only closed
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+    }
+    while (!errorCode && !stopped)
+    {
+        StatsPhase(&stats, WAIT_PHASE);
+        int client = accept(listener, NULL, NULL);
+        if (client < 0)
+        {
+            if (errno != EINTR && errno != ECONNABORTED)
+                errorCode = FILE_ERR;
+            continue;
+        }
+        ServeBatch(&server, client); // errors of batch are sent to client
+        close(client);
+    }
+
+    StatsPhase(&stats, OUTPUT_PHASE);
+    if (listener >= 0)
+        close(listener);
+    if (bound)
+        unlink(address);
+    FreeDefinitions(&server);
+
+    return errorCode;
+}
+
+// Function to load definitions from file which has only universum, sets and relations (with more jobs they are parsed by more threads)
+int LoadDefinitions(server_t *server, string path)
+{
+    int first = 0; // the first line which isn't parsed yet
+
+    int errorCode = 0; // error code to specify error by its code
+
+    ArenaInit(&server->arena, ARENA_BLOCK);
+    ArenaInit(&server->scratch, ARENA_BLOCK);
+    if ((errorCode = LoadInput(path, &server->input)))
+    {
+        server->input.data = NULL;
+        server->input.lines = NULL;
+        return errorCode;
+    }
+    server->count = server->input.count;
+
+    // file has universum and definitions only (commands are executed in batches)
+    if (!server->count || server->input.lines[0][0] != UNIVERSUM)
+        return ARGS_ERR;
+    for (int i = 1; i < server->count; i++)
+        if (server->input.lines[i][0] == COMMAND)
+            return ARGS_ERR;
+
+    if ((errorCode = __reserve_lines(server, server->count)))
+        return errorCode;
+    StatsPhase(&stats, UNIVERSUM_PHASE);
+    if ((server->universum = ArenaCalloc(&server->arena, sizeof(symtab_t))) == NULL)
+        return MEMORY_ERR;
+    if ((errorCode = ValidateUniversum(server->input.lines[0], server->universum, &server->arena)))
+    {
+        errorInfo.line = 1;
+        return errorCode;
+    }
+    StatsPhase(&stats, DEFINITIONS_PHASE);
+
+    // definitions are parsed by more threads, the first line with error is parsed again (by the loop below)
+    if (server->jobs > 1 && (server->threads = calloc(server->jobs, sizeof(parsing_t))) != NULL)
+    {
+        parser_t parser = {server->input.lines, server->count, server->universum, server->defs, 0, 0, PTHREAD_MUTEX_INITIALIZER};
+        first = ParallelParsing(&parser, server->threads, server->jobs);
+    }
+    for (int i = first; i < server->count; i++)
+    {
+        if ((errorCode = ParseDefinition(server->input.lines[i], i, server->universum, &server->defs[i], &server->arena)))
+        {
+            errorInfo.line = i + 1;
+            return errorCode;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+// frees definitions, results of commands and input (or mapped snapshot) which they were parsed from
+void FreeDefinitions(server_t *server)
+{
+    for (int i = 0; server->defs != NULL && i < server->capacity; i++)
+        FreeDefinition(&server->defs[i]);
+    for (int i = 0; server->threads != NULL && i < server->jobs; i++)
+        ArenaFree(&server->threads[i].arena);
+    free(server->threads);
+    free(server->defs);
+    free(server->firstUse);
+    free(server->lastUse);
+    if (server->input.data != NULL || server->input.lines != NULL)
+        FreeInput(&server->input);
+    ArenaFree(&server->scratch);
+    ArenaFree(&server->arena);
+}
+
+// Function to execute batch of commands on loaded definitions (commands are numbered like lines appended to the definitions).
+// Output of every command ends by new line
+int ExecuteBatch(server_t *server, input_t *batch, output_t *out)
+{
+    int lineCount = server->count + batch->count;
+
+    int errorCode = __reserve_lines(server, lineCount); // error code to specify error by its code
+
+    // batch has only commands (definitions after commands aren't allowed)
+    for (int i = 0; !errorCode && i < batch->count; i++)
+    {
+        if (batch->lines[i][0] != COMMAND)
+            errorCode = ARGS_ERR;
+        server->input.lines[server->count + i] = batch->lines[i];
+    }
+
+    if (!errorCode)
+    {
+        memset(server->firstUse + server->count, 0, batch->count * sizeof(int));
+        memset(server->lastUse + server->count, 0, batch->count * sizeof(int));
+        FindReferences(server->input.lines, server->count, lineCount, server->firstUse, server->lastUse);
+
+        context_t ctx = {server->universum, &server->scratch, out, NULL, StatsCounters(&stats)};
+        errorCode = ExecuteLines(server->input.lines, lineCount, server->count, server->defs, server->firstUse, server->lastUse, &ctx, &server->arena, server->jobs);
+        if (!errorCode && batch->count)
+            OutputChar(out, '\n');
+    }
+
+    for (int i = server->count; i < lineCount && i < server->capacity; i++)
+        FreeDefinition(&server->defs[i]); // results of commands of batch
+    return errorCode;
+}
+
+// Function to execute batch of commands sent by client. Output of commands is sent back and it is ended by '\0' and error code,
+// details of error follow it (line and element, if there are any)
+int ServeBatch(server_t *server, int client)
+{
+    input_t batch;   // commands sent by client
+    output_t output; // output for client
+
+    int errorCode = 0; // error code to specify error by its code
+
+    if (OutputInit(&output, client, OUTPUT_BUFFER))
+        return MEMORY_ERR;
+    StatsPhase(&stats, LOAD_PHASE);
+    if (!(errorCode = ReadInput(client, &batch, true)))
+    {
+        errorCode = ExecuteBatch(server, &batch, &output);
+        FreeInput(&batch);
+    }
+
+    // end of output, error code and details of error (if there are any)
+    OutputChar(&output, '\0');
+    OutputChar(&output, errorCode);
+    if (errorCode && errorInfo.element != NULL)
+    {
+        OutputNumber(&output, errorInfo.line);
+        OutputChar(&output, ' ');
+        OutputString(&output, errorInfo.element);
+    }
+    free(errorInfo.element);
+    errorInfo.element = NULL;
+    errorInfo.line = 0;
+    StatsPhase(&stats, OUTPUT_PHASE);
+    OutputFree(&output);
+
+    return errorCode;
+}
+
+// handler of SIGINT and SIGTERM, server stops after current batch (and --watch after current version of file)
+void StopServer(int signal)
+{
+    (void)signal;
+    stopped = 1;
+}
+
+// Function to send commands from input to server and to print their output, error of commands is returned with its details
+int ClientExecution(string path, string address)
+{
+    struct sockaddr_un name = {.sun_family = AF_UNIX};
+    output_t output;  // buffered standard output
+    output_t trailer; // error code and details of error after the end of output
+    char *buffer;     // chunk of input or of output
+    ssize_t length;
+    bool ended = false; // true if the end of output was received
+
+    int errorCode = 0; // error code to specify error by its code
+
+    if (strlen(address) >= sizeof(name.sun_path))
+        return ARGS_ERR;
+    strcpy(name.sun_path, address);
+
+    int fd = strcmp(path, STDIN) ? open(path, O_RDONLY) : STDIN_FILENO;
+    if (fd < 0) // if we can't open file (wrong name or something like this)
+        return FILE_ERR;
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0 || connect(server, (struct sockaddr *)&name, sizeof(name)))
+        errorCode = FILE_ERR;
+    else if (allocate(buffer, READ_CHUNK))
+        errorCode = MEMORY_ERR;
+    else if (OutputInit(&output, STDOUT_FILENO, OUTPUT_BUFFER) || OutputInit(&trailer, -1, RESULT_BUFFER))
+    {
+        free(buffer);
+        errorCode = MEMORY_ERR;
+    }
+    if (errorCode)
+    {
+        if (server >= 0)
+            close(server);
+        if (fd != STDIN_FILENO)
+            close(fd);
+        return errorCode;
+    }
+
+    // the whole input is sent first, server answers after its end
+    signal(SIGPIPE, SIG_IGN);
+    while (!errorCode && (length = read(fd, buffer, READ_CHUNK)) > 0)
+    {
+        char *data = buffer;
+        for (ssize_t written; length && (written = write(server, data, length)) > 0; length -= written)
+            data += written;
+        if (length) // server closed connection
+            errorCode = FILE_ERR;
+    }
+    if (length < 0)
+        errorCode = FILE_ERR;
+    shutdown(server, SHUT_WR);
+
+    // output is copied till '\0', the rest is error code and details of error
+    while (!errorCode && (length = read(server, buffer, READ_CHUNK)) > 0)
+    {
+        char *end = ended ? buffer : memchr(buffer, '\0', length);
+        size_t size = end != NULL ? (size_t)(end - buffer) : (size_t)length;
+        OutputWrite(&output, buffer, size);
+        if (end != NULL)
+        {
+            ended = true;
+            OutputWrite(&trailer, end, length - size);
+        }
+    }
+    OutputChar(&trailer, '\0');
+
+    if (!errorCode && (trailer.lost || trailer.size < 3)) // server didn't answer the whole batch
+        errorCode = FILE_ERR;
+    else if (!errorCode && (errorCode = trailer.data[1]) && trailer.size > 3) // the same details as server would print
+    {
+        errorInfo.line = atoi(trailer.data + 2);
+        string element = strchr(trailer.data + 2, ' ');
+        if (element != NULL && (errorInfo.element = malloc(strlen(element))) != NULL)
+            strcpy(errorInfo.element, element + 1);
+    }
+
+    OutputFree(&output); // output is written before error message
+    OutputFree(&trailer);
+    free(buffer);
+    close(server);
+    if (fd != STDIN_FILENO)
+        close(fd);
+    return errorCode;
+}
+
+// Function to save definitions from file into snapshot, or to execute commands from file on definitions from snapshot
+int SnapshotExecution(string path, string snapshot, bool save, int jobs)
+{
+    server_t server = {.jobs = jobs};
+    input_t batch;   // commands
+    output_t output; // buffered standard output
+
+    int errorCode = 0; // error code to specify error by its code
+
+    if (save)
+    {
+        if (!(errorCode = LoadDefinitions(&server, path)))
+        {
+            StatsPhase(&stats, OUTPUT_PHASE);
+            errorCode = SaveSnapshot(&server, snapshot);
+        }
+    }
+    else if (!(errorCode = LoadSnapshot(&server, snapshot)) && !(errorCode = LoadInput(path, &batch)))
+    {
+        if (OutputInit(&output, STDOUT_FILENO, OUTPUT_BUFFER))
+            errorCode = MEMORY_ERR;
+        else
+        {
+            errorCode = ExecuteBatch(&server, &batch, &output);
+            StatsPhase(&stats, OUTPUT_PHASE);
+            OutputFree(&output); // output is written before error message
+        }
+        FreeInput(&batch);
+    }
+
+    StatsPhase(&stats, OUTPUT_PHASE);
+    FreeDefinitions(&server);
+    return errorCode;
+}
+
+// writes section of snapshot, zeros after it align the next section to 8 bytes
+void __write_section(output_t *out, const void *data, size_t size)
+{
+    static const char zeros[sizeof(uint64_t)];
+    OutputWrite(out, data, size);
+    OutputWrite(out, zeros, Align8(size) - size);
+}
+
+// Function to write parsed definitions into snapshot: header, records of lines, containers and their words of sets, pairs of relations
+// and symbol table of universum. Every section is aligned to 8 bytes, so the file can be mapped and used as it is
+int SaveSnapshot(server_t *server, string path)
+{
+    symtab_t *universum = server->universum;
+    snapshot_t header = {.version = SNAPSHOT_VERSION, .lineCount = server->count, .count = universum->count, .mask = universum->mask};
+    record_t *records;
+    output_t output;
+    struct stat info;
+    uint64_t offset = sizeof(snapshot_t) + server->count * sizeof(record_t); // offset of data of the next line
+
+    int errorCode = 0; // error code to specify error by its code
+
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    if (universum->count) // names are ended by '\0' in pool
+        header.poolSize = universum->names[universum->count - 1] + universum->lengths[universum->count - 1] + 1;
+
+    if ((records = calloc(server->count, sizeof(record_t))) == NULL)
+        return MEMORY_ERR;
+    for (int i = 0; i < server->count; i++)
+    {
+        def_t *def = &server->defs[i];
+        records[i].kind = server->input.lines[i][0];
+        records[i].count = def->set != NULL ? (uint32_t)def->set->count : (uint32_t)def->rel->count;
+        records[i].offset = offset;
+        if (def->set != NULL)
+        {
+            records[i].size = def->set->size;
+            for (uint32_t c = 0; c < def->set->size; c++)
+                records[i].words += ContainerWords(def->set->containers[c].type, def->set->containers[c].size);
+        }
+        offset += def->set != NULL ? records[i].size * sizeof(container_t) + records[i].words * sizeof(uint64_t) : records[i].count * sizeof(pair_t);
+    }
+    header.symbols = offset;
+    header.size = offset + universum->count * sizeof(uint64_t) + Align8(universum->count * sizeof(uint32_t)) +
+                  Align8(((uint64_t)universum->mask + 1) * sizeof(uint32_t)) + Align8(header.poolSize);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        free(records);
+        return FILE_ERR;
+    }
+    if (OutputInit(&output, fd, OUTPUT_BUFFER))
+        errorCode = MEMORY_ERR;
+    else
+    {
+        __write_section(&output, &header, sizeof(header)); // checksum is written at the end
+        __write_section(&output, records, server->count * sizeof(record_t));
+        for (int i = 0; i < server->count; i++)
+        {
+            def_t *def = &server->defs[i];
+            if (def->set != NULL)
+            {
+                __write_section(&output, def->set->containers, records[i].size * sizeof(container_t));
+                __write_section(&output, def->set->data, records[i].words * sizeof(uint64_t));
+            }
+            else
+                __write_section(&output, def->rel->pair, def->rel->count * sizeof(pair_t));
+        }
+        __write_section(&output, universum->names, universum->count * sizeof(uint64_t));
+        __write_section(&output, universum->lengths, universum->count * sizeof(uint32_t));
+        __write_section(&output, universum->slots, ((size_t)universum->mask + 1) * sizeof(uint32_t));
+        __write_section(&output, universum->pool, header.poolSize);
+        OutputFree(&output);
+
+        // the file is read back for checksum (output doesn't report failed writes, so size of file is checked too)
+        void *data = MAP_FAILED;
+        if (fstat(fd, &info) || (uint64_t)info.st_size != header.size ||
+            (data = mmap(NULL, header.size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+            errorCode = FILE_ERR;
+        else
+        {
+            header.checksum = Checksum((uint64_t *)data + sizeof(header) / sizeof(uint64_t), (header.size - sizeof(header)) / sizeof(uint64_t));
+            if (pwrite(fd, &header, sizeof(header), 0) != sizeof(header))
+                errorCode = FILE_ERR;
+        }
+        if (data != MAP_FAILED)
+            munmap(data, header.size);
+    }
+
+    free(records);
+    if (close(fd) && !errorCode)
+        errorCode = FILE_ERR;
+    if (errorCode)
+        unlink(path); // incomplete snapshot isn't left
+    return errorCode;
+}
+
+// checks set mapped from snapshot like builder makes it: containers one after another in words of set, sorted keys, sorted values
+// (separated runs) of IDs of universum, zero padding and counts which fit values (mapped set is used without any other checks)
+bool __valid_set(const set_t *set, uint64_t words, uint32_t elements)
+{
+    uint64_t count = 0, end = 0; // count of elements and words of containers before the current one
+
+    for (uint32_t c = 0; c < set->size; c++)
+    {
+        const container_t *container = &set->containers[c];
+        uint32_t type = container->type, size = container->size, n = 0, last = 0; // n - count of values, last - the biggest value
+
+        if ((type != ARRAY_CONTAINER && type != BITMAP_CONTAINER && type != RUN_CONTAINER) || (c && container->key <= set->containers[c - 1].key) ||
+            !size || size > (type == ARRAY_CONTAINER ? ARRAY_MAX : type == RUN_CONTAINER ? 1 << (CHUNK_BITS - 1) : CHUNK_WORDS) ||
+            (type == BITMAP_CONTAINER && size != CHUNK_WORDS) || container->offset != end || words - end < ContainerWords(type, size))
+            return false;
+
+        const uint64_t *data = set->data + end;
+        const uint16_t *values = (const uint16_t *)data;
+        end += ContainerWords(type, size);
+        if (type == BITMAP_CONTAINER)
+        {
+            uint32_t w = CHUNK_WORDS;
+            while (w > 1 && !data[w - 1]) // the biggest value is in the last word which isn't zero
+                w--;
+            for (uint64_t word = data[w - 1]; word; word &= word - 1)
+                last = (w - 1) * WORD_BITS + Ctz64(word);
+            n = kernels.popcount(data, CHUNK_WORDS);
+        }
+        else
+        {
+            uint32_t length = type == ARRAY_CONTAINER ? size : 2 * size; // count of 16-bit values without padding
+            for (uint32_t k = 0; k < length; k += type == ARRAY_CONTAINER ? 1 : 2)
+            {
+                if (k && values[k] <= last + (type == RUN_CONTAINER)) // runs are separated by value which isn't in set
+                    return false;
+                if (type == ARRAY_CONTAINER)
+                    last = values[k];
+                else if ((last = values[k] + values[k + 1]) >> CHUNK_BITS) // run ends after the chunk
+                    return false;
+                n += type == ARRAY_CONTAINER ? 1 : values[k + 1] + 1;
+            }
+            for (uint32_t k = length; k % 4; k++)
+                if (values[k])
+                    return false;
+        }
+        if (!n || n != container->count || ((uint64_t)container->key << CHUNK_BITS | last) >= elements)
+            return false;
+        count += n;
+    }
+    return end == words && count == (uint64_t)set->count;
+}
+
+// checks symbol table mapped from snapshot: names with their lengths are in pool (ended by '\0') and hash table has IDs of universum
+// in as many slots as universum has elements (so lookup always finds empty slot)
+bool __valid_symbols(const symtab_t *universum, uint64_t poolSize)
+{
+    uint64_t used = 0; // count of slots which aren't empty
+
+    for (uint32_t id = 0; id < universum->count; id++)
+        if (universum->names[id] >= poolSize || universum->lengths[id] >= poolSize - universum->names[id] ||
+            universum->pool[universum->names[id] + universum->lengths[id]])
+            return false;
+    for (uint64_t slot = 0; slot <= universum->mask; slot++)
+        if (universum->slots[slot] && (universum->slots[slot] > universum->count || ++used > universum->count))
+            return false;
+    return used == universum->count;
+}
+
+// Function to map snapshot and to use its definitions without parsing, only structs of sets and relations point into it.
+// Checksum finds damaged snapshot, so every line is checked too (file with right checksum can still have IDs out of universum)
+int LoadSnapshot(server_t *server, string path)
+{
+    struct stat info;
+    char *data;
+
+    int errorCode = 0; // error code to specify error by its code
+
+    ArenaInit(&server->arena, ARENA_BLOCK);
+    ArenaInit(&server->scratch, ARENA_BLOCK);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) // if we can't open file (wrong name or something like this)
+        return FILE_ERR;
+    if (fstat(fd, &info) || info.st_size < (off_t)sizeof(snapshot_t) || (data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    {
+        close(fd);
+        return FILE_ERR;
+    }
+    close(fd);
+    server->input.data = data; // snapshot is unmapped like mapped input
+    server->input.size = info.st_size;
+    server->input.mapped = true;
+
+    snapshot_t *header = (snapshot_t *)data;
+    record_t *records = (record_t *)(data + sizeof(snapshot_t));
+    uint64_t size = info.st_size;
+
+    // header has to fit the file (snapshot can be from other version or it can be damaged)
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) || header->version != SNAPSHOT_VERSION || header->size != size ||
+        size % sizeof(uint64_t) || !header->lineCount || header->lineCount > INT_MAX || header->lineCount > (size - sizeof(snapshot_t)) / sizeof(record_t) ||
+        (header->mask & (header->mask + 1)) || header->mask < header->count || header->count > INT_MAX)
+        return FILE_ERR;
+    if (Checksum((uint64_t *)data + sizeof(snapshot_t) / sizeof(uint64_t), (size - sizeof(snapshot_t)) / sizeof(uint64_t)) != header->checksum)
+        return FILE_ERR;
+
+    // symbol table of universum is the last section
+    symtab_t *universum;
+    if ((server->universum = universum = ArenaCalloc(&server->arena, sizeof(symtab_t))) == NULL)
+        return MEMORY_ERR;
+    universum->count = header->count;
+    universum->mask = header->mask;
+    universum->words = BitsetWords(universum->count);
+    uint64_t symbols = header->symbols;
+    if (symbols > size || size - symbols != universum->count * sizeof(uint64_t) + Align8(universum->count * sizeof(uint32_t)) +
+                                                  Align8(((uint64_t)universum->mask + 1) * sizeof(uint32_t)) + Align8(header->poolSize))
+        return FILE_ERR;
+    universum->names = (uint64_t *)(data + symbols);
+    universum->lengths = (uint32_t *)(data + symbols + universum->count * sizeof(uint64_t));
+    universum->slots = (uint32_t *)((char *)universum->lengths + Align8(universum->count * sizeof(uint32_t)));
+    universum->pool = (char *)universum->slots + Align8(((uint64_t)universum->mask + 1) * sizeof(uint32_t));
+    if (!__valid_symbols(universum, header->poolSize))
+        return FILE_ERR;
+
+    server->count = header->lineCount;
+    if ((errorCode = __reserve_lines(server, server->count)))
+        return errorCode;
+    for (int i = 0; i < server->count; i++)
+    {
+        record_t *record = &records[i];
+        def_t *def = &server->defs[i];
+        bool set = record->kind == SET || (record->kind == UNIVERSUM && !i);
+        uint64_t end = record->offset + (set ? record->size * sizeof(container_t) + (uint64_t)record->words * sizeof(uint64_t) : record->count * sizeof(pair_t));
+
+        // data of line have to be between records and symbol table
+        if ((!set && record->kind != RELATION) || (!i && (record->kind != UNIVERSUM || record->count != header->count)) ||
+            record->count > INT_MAX || record->offset % sizeof(uint64_t) ||
+            record->offset < sizeof(snapshot_t) + header->lineCount * sizeof(record_t) || end > symbols || end < record->offset)
+            return FILE_ERR;
+        server->input.lines[i] = record->kind == UNIVERSUM ? "U" : set ? "S" : "R"; // commands only check kinds of lines
+
+        if (set && (def->set = ArenaAlloc(&server->arena, sizeof(set_t))) != NULL)
+            *def->set = (set_t){(container_t *)(data + record->offset), record->size, record->count,
+                                (uint64_t *)(data + record->offset + record->size * sizeof(container_t))};
+        else if (!set && (def->rel = ArenaAlloc(&server->arena, sizeof(rel_t))) != NULL)
+            *def->rel = (rel_t){(pair_t *)(data + record->offset), record->count};
+        else
+            return MEMORY_ERR;
+
+        // universum set has all the IDs, because it has count of universum and IDs are sorted and smaller than count
+        if (set && !__valid_set(def->set, record->words, universum->count))
+            return FILE_ERR;
+        for (int p = 0; !set && p < def->rel->count; p++)
+            if (def->rel->pair[p].elements[0] >= universum->count || def->rel->pair[p].elements[1] >= universum->count)
+                return FILE_ERR;
+    }
+    universum->set = server->defs[0].set;
+    return EXIT_SUCCESS;
+}
+
+// checksum of words of snapshot (damaged or incomplete snapshot isn't used)
+uint64_t Checksum(const uint64_t *words, size_t count)
+{
+    uint64_t hash = 14695981039346656037u;
+    for (size_t i = 0; i < count; i++)
+    {
+        hash = (hash ^ words[i]) * 1099511628211u;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+// hash of line or of output of command (FNV-1a)
+uint64_t __hash_bytes(const char *data, size_t size)
+{
+    uint64_t hash = 14695981039346656037u;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211u;
+    return hash;
+}
+
+// Function to execute file and to execute it again whenever it is changed (till SIGINT or SIGTERM). The first version is printed
+// whole, the next ones print only results of commands which changed (as "line: result"). Error is printed and the next version
+// of file is executed whole. File is read (not mapped), so editor can rewrite it while it is executed
+int WatchExecution(string path)
+{
+    watch_t watch = {.path = path};
+    struct sigaction action = {.sa_handler = StopServer}; // read of events is interrupted by signal (without SA_RESTART)
+    output_t output; // buffered standard output
+    int fd = -1;     // inotify instance watching directory of file (editors often replace file by renaming other one)
+
+    int errorCode = 0; // error code to specify error by its code
+
+    if (OutputInit(&output, STDOUT_FILENO, OUTPUT_BUFFER) || OutputInit(&watch.result, -1, RESULT_BUFFER))
+    {
+        free(output.data);
+        return MEMORY_ERR;
+    }
+    ArenaInit(&watch.arena, ARENA_BLOCK);
+    ArenaInit(&watch.scratch, ARENA_BLOCK);
+    cache.lines = 0; // outputs of commands change with definitions
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+#ifdef __linux__
+    string name = strrchr(path, '/');
+    char *directory = strdup(path);
+    if (directory == NULL)
+        errorCode = MEMORY_ERR;
+    else if (name != NULL)
+        directory[name - path + (name == path)] = '\0'; // file in root directory keeps "/"
+    if (!errorCode && ((fd = inotify_init()) < 0 || inotify_add_watch(fd, name != NULL ? directory : ".", IN_CLOSE_WRITE | IN_MOVED_TO) < 0))
+        errorCode = FILE_ERR;
+    free(directory);
+#endif
+
+    // every version of file is executed (the first one immediately)
+    for (bool changed = true; !errorCode && changed; changed = WaitChange(&watch, fd))
+    {
+        input_t input;
+        int file;
+
+        StatsPhase(&stats, LOAD_PHASE);
+        if ((file = open(path, O_RDONLY)) < 0)
+            errorCode = FILE_ERR;
+        else
+        {
+            if (!(errorCode = ReadInput(file, &input, false)))
+            {
+                if (!(errorCode = CheckLines(input.lines, input.count)))
+                    errorCode = WatchRun(&watch, input.lines, input.count, &output);
+                FreeInput(&input);
+            }
+            close(file);
+        }
+
+        StatsPhase(&stats, OUTPUT_PHASE);
+        OutputFlush(&output); // output is written before error message
+        if (errorCode == MEMORY_ERR)
+            break;
+        if (errorCode) // the next version is executed whole
+        {
+            PrintError(errorCode);
+            fprintf(stderr, "\n");
+            watch.count = 0;
+            errorCode = 0;
+        }
+        free(errorInfo.element);
+        errorInfo.element = NULL;
+        errorInfo.line = 0;
+    }
+
+    StatsPhase(&stats, OUTPUT_PHASE);
+    if (fd >= 0)
+        close(fd);
+    OutputFree(&output);
+    FreeWatch(&watch);
+    return errorCode;
+}
+
+// resizes arrays indexed by lines of watched file (new definitions are empty)
+int __reserve_watch(watch_t *watch, int lineCount)
+{
+    void *error;
+
+    if (lineCount <= watch->capacity)
+        return EXIT_SUCCESS;
+    if (reallocate(error, watch->defs, lineCount * sizeof(def_t)))
+        return MEMORY_ERR;
+    watch->defs = error;
+    memset(watch->defs + watch->capacity, 0, (lineCount - watch->capacity) * sizeof(def_t));
+    watch->capacity = lineCount;
+    free(watch->firstUse);
+    free(watch->lastUse);
+    free(watch->lines);
+    free(watch->outputs);
+    free(watch->dirty);
+    watch->firstUse = malloc(lineCount * sizeof(int));
+    watch->lastUse = malloc(lineCount * sizeof(int));
+    watch->lines = malloc(lineCount * sizeof(uint64_t));
+    watch->outputs = malloc(lineCount * sizeof(uint64_t));
+    watch->dirty = malloc(lineCount * sizeof(bool));
+    if (watch->firstUse == NULL || watch->lastUse == NULL || watch->lines == NULL || watch->outputs == NULL || watch->dirty == NULL)
+    {
+        watch->capacity = 0; // the next version tries to allocate them again
+        return MEMORY_ERR;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Function to execute new version of watched file. Lines are compared with the last version by their hashes, changed definitions
+// are parsed again and only commands which changed or which refer to dirty lines (directly or through results of other commands)
+// are executed again. Version with other count of lines or with other universum (or version after error) is executed whole
+int WatchRun(watch_t *watch, string *lines, int lineCount, output_t *out)
+{
+    context_t ctx = {watch->universum, &watch->scratch, &watch->result, NULL, StatsCounters(&stats)};
+    bool whole = watch->count != lineCount || watch->lines[0] != __hash_bytes(lines[0], strlen(lines[0]));
+    exp_t expression;
+
+    int errorCode = 0; // error code to specify error by its code
+
+    watch->count = 0; // version is valid only if it is executed without error
+    if (whole)
+    {
+        StatsPhase(&stats, UNIVERSUM_PHASE);
+        for (int i = 0; i < watch->capacity; i++)
+            FreeDefinition(&watch->defs[i]);
+        ArenaFree(&watch->arena);
+        if (lines[0][0] != UNIVERSUM)
+            return ARGS_ERR;
+        if ((errorCode = __reserve_watch(watch, lineCount)))
+            return errorCode;
+        if ((watch->universum = ArenaCalloc(&watch->arena, sizeof(symtab_t))) == NULL)
+            return MEMORY_ERR;
+        if ((errorCode = ValidateUniversum(lines[0], watch->universum, &watch->arena)))
+        {
+            errorInfo.line = 1;
+            return errorCode;
+        }
+        ctx.universum = watch->universum;
+        watch->lines[0] = __hash_bytes(lines[0], strlen(lines[0]));
+        watch->defs[0].set = watch->universum->set;
+        watch->dirty[0] = true;
+        OutputLine(out, lines[0]);
+    }
+    memset(watch->firstUse, 0, lineCount * sizeof(int));
+    memset(watch->lastUse, 0, lineCount * sizeof(int));
+    FindReferences(lines, 0, lineCount, watch->firstUse, watch->lastUse);
+
+    for (int i = 1; !errorCode && i < lineCount; i++)
+    {
+        size_t length = strlen(lines[i]);
+        uint64_t hash = __hash_bytes(lines[i], length);
+        def_t *def = &watch->defs[i];
+        watch->dirty[i] = whole || hash != watch->lines[i];
+        watch->lines[i] = hash;
+
+        if (lines[i][0] != COMMAND)
+        {
+            if (!watch->dirty[i])
+                continue;
+            StatsPhase(&stats, DEFINITIONS_PHASE);
+            FreeDefinition(def);
+            ArenaInit(&def->arena, 2 * length + 128); // changed definition is released on its own
+            if ((errorCode = ParseDefinition(lines[i], i, watch->universum, def, &def->arena)))
+                errorInfo.line = i + 1;
+            else if (whole)
+                OutputLine(out, lines[i]);
+            continue;
+        }
+
+        // command is executed again if some line which it refers to is dirty or if its result wasn't kept, but now it is referred to
+        if (!watch->dirty[i] && !StringToExpression(lines[i], &expression))
+            for (int j = 0; j < expression.argumentLength; j++)
+                if (expression.arguments[j] >= 0 && expression.arguments[j] < i && watch->dirty[expression.arguments[j]])
+                    watch->dirty[i] = true;
+        if (watch->firstUse[i] && def->set == NULL && def->rel == NULL)
+            watch->dirty[i] = true;
+        if (!watch->firstUse[i])
+            FreeDefinition(def); // no command refers to result anymore
+        if (!watch->dirty[i])
+            continue;
+
+        StatsPhase(&stats, COMMANDS_PHASE);
+        FreeDefinition(def);
+        reset(watch->result.size);
+        ctx.result = watch->firstUse[i] ? def : NULL;
+        if ((errorCode = ExecuteCommand(lines[i], watch->defs, i, &ctx)))
+            break;
+        if (watch->result.lost)
+            return MEMORY_ERR;
+
+        // only changed results are printed (with number of line) after the first version
+        hash = __hash_bytes(watch->result.data, watch->result.size);
+        if (!whole && hash != watch->outputs[i])
+        {
+            OutputNumber(out, i + 1);
+            OutputString(out, ": ");
+        }
+        if (whole || hash != watch->outputs[i])
+        {
+            OutputWrite(out, watch->result.data, watch->result.size);
+            OutputChar(out, '\n');
+        }
+        watch->outputs[i] = hash;
+    }
+
+    if (!errorCode)
+        watch->count = lineCount;
+    return errorCode;
+}
+
+// waits till watched file is changed, returns false if watching stopped (by signal or error)
+bool WaitChange(watch_t *watch, int fd)
+{
+    StatsPhase(&stats, WAIT_PHASE);
+#ifdef __linux__
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    string name = strrchr(watch->path, '/') != NULL ? strrchr(watch->path, '/') + 1 : watch->path;
+
+    while (!stopped)
+    {
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length < 0 && errno == EINTR)
+            continue;
+        if (length <= 0)
+            return false;
+        // all the events which are read at once are one change
+        for (char *event = buffer; event < buffer + length; event += sizeof(struct inotify_event) + ((struct inotify_event *)event)->len)
+            if (((struct inotify_event *)event)->len && !strcmp(((struct inotify_event *)event)->name, name))
+                return !stopped;
+    }
+    return false;
+#else
+    struct stat info;
+    struct timespec delay = {WATCH_POLL / 1000, WATCH_POLL % 1000 * 1000000};
+    time_t modified = stat(watch->path, &info) ? 0 : info.st_mtime;
+
+    (void)fd;
+    while (!stopped)
+    {
+        nanosleep(&delay, NULL);
+        if (!stat(watch->path, &info) && info.st_mtime != modified)
+            return !stopped;
+    }
+    return false;
+#endif
+}
+
+void FreeWatch(watch_t *watch)
+{
+    for (int i = 0; i < watch->capacity; i++)
+        FreeDefinition(&watch->defs[i]);
+    free(watch->defs);
+    free(watch->firstUse);
+    free(watch->lastUse);
+    free(watch->lines);
+    free(watch->outputs);
+    free(watch->dirty);
+    free(watch->result.data);
+    ArenaFree(&watch->scratch);
+    ArenaFree(&watch->arena);
+}
+
+// Function to execute commands from lines begin..end-1 by more threads (work stealing), their results are written in the order of lines
+int ParallelExecution(string *lines, int lineCount, int begin, int end, def_t *defs, int *firstUse, context_t *ctx, int jobs)
+{
+    pool_t pool = {lines, lineCount, begin, end, defs, firstUse, ctx->universum, jobs, NULL, NULL, NULL, begin, ctx->out, 0, false, PTHREAD_MUTEX_INITIALIZER};
+    worker_t *workers = NULL;
+    int count = end - begin; // count of commands
+    int created = 1;         // count of running threads (the first one is this thread)
+
+    if ((pool.queues = calloc(jobs, sizeof(queue_t))) == NULL || (pool.results = calloc(count, sizeof(output_t))) == NULL ||
+        (pool.errors = malloc(count * sizeof(int))) == NULL || (workers = calloc(jobs, sizeof(worker_t))) == NULL)
+        pool.errorCode = MEMORY_ERR;
+    for (int i = 0; pool.queues != NULL && i < jobs; i++)
+        pthread_mutex_init(&pool.queues[i].lock, NULL);
+
+    // commands are dealt to queues one by one, so the first commands are executed first (their output is written first)
+    for (int i = 0; !pool.errorCode && i < jobs; i++)
+    {
+        if ((pool.queues[i].tasks = malloc((count / jobs + 1) * sizeof(int))) == NULL)
+            pool.errorCode = MEMORY_ERR;
+    }
+    for (int i = 0; !pool.errorCode && i < count; i++)
+    {
+        queue_t *queue = &pool.queues[i % jobs];
+        queue->tasks[queue->tail++] = begin + i;
+        pool.errors[i] = -1;
+    }
+
+    if (!pool.errorCode)
+    {
+        for (int i = 0; i < jobs; i++)
+        {
+            workers[i].pool = &pool;
+            workers[i].id = i;
+        }
+        for (; created < jobs; created++) // if thread can't be created, commands are executed by less threads
+            if (pthread_create(&workers[created].thread, NULL, Worker, &workers[created]))
+                break;
+        Worker(&workers[0]);
+        for (int i = 1; i < created; i++)
+            pthread_join(workers[i].thread, NULL);
+    }
+
+    for (int i = 0; pool.queues != NULL && i < jobs; i++)
+    {
+        free(pool.queues[i].tasks);
+        pthread_mutex_destroy(&pool.queues[i].lock);
+    }
+    for (int i = 0; pool.results != NULL && i < count; i++)
+        free(pool.results[i].data);
+    pthread_mutex_destroy(&pool.lock);
+    free(pool.queues);
+    free(pool.results);
+    free(pool.errors);
+    free(workers);
+
+    return pool.errorCode;
+}
+
+// Function to parse definitions before the first command by more threads, returns the first line which can't be parsed
+int ParallelParsing(parser_t *parser, parsing_t *threads, int jobs)
+{
+    int created = 1; // count of running threads (the first one is this thread)
+
+    parser->failed = parser->end;
+    for (int i = 0; i < jobs; i++)
+    {
+        threads[i].parser = parser;
+        ArenaInit(&threads[i].arena, ARENA_BLOCK);
+    }
+    for (; created < jobs; created++) // if thread can't be created, definitions are parsed by less threads
+        if (pthread_create(&threads[created].thread, NULL, ParseWorker, &threads[created]))
+            break;
+    ParseWorker(&threads[0]);
+    for (int i = 1; i < created; i++)
+        pthread_join(threads[i].thread, NULL);
+
+    pthread_mutex_destroy(&parser->lock);
+    return parser->failed;
+}
+
+// thread which takes chunks of lines and parses them (chunks after a line with error are skipped)
+void *ParseWorker(void *arg)
+{
+    parsing_t *thread = arg;
+    parser_t *parser = thread->parser;
+
+    while (true)
+    {
+        pthread_mutex_lock(&parser->lock);
+        int begin = parser->next;
+        int end = begin + PARSE_CHUNK < parser->end ? begin + PARSE_CHUNK : parser->end;
+        parser->next = end;
+        bool skip = begin >= parser->failed;
+        pthread_mutex_unlock(&parser->lock);
+        if (begin >= end || skip)
+            break;
+
+        for (int i = begin; i < end; i++)
+        {
+            if (ParseDefinition(parser->lines[i], i, parser->universum, &parser->defs[i], &thread->arena))
+            {
+                pthread_mutex_lock(&parser->lock);
+                if (i < parser->failed)
+                    parser->failed = i;
+                pthread_mutex_unlock(&parser->lock);
+                break;
+            }
+        }
+    }
+    return NULL;
+}
+
+// thread which executes commands, every command writes its result into own buffer
+void *Worker(void *arg)
+{
+    worker_t *worker = arg;
+    pool_t *pool = worker->pool;
+    arena_t scratch;     // own memory for temporaries of commands
+    counters_t counters; // own counters of commands (added to statistics at the end)
+    bool stop = false;
+
+    ArenaInit(&scratch, ARENA_BLOCK);
+    if (stats.enabled)
+        memset(&counters, 0, sizeof(counters_t));
+    context_t ctx = {pool->universum, &scratch, NULL, NULL, stats.enabled ? &counters : NULL};
+
+    for (int line; !stop && (line = TakeTask(pool, worker->id)) >= 0;)
+    {
+        output_t *result = &pool->results[line - pool->begin];
+        int errorCode;
+
+        if ((errorCode = OutputInit(result, -1, RESULT_BUFFER)) == 0)
+        {
+            ctx.out = result;
+            ctx.result = pool->firstUse[line] ? &pool->defs[line] : NULL; // commands which refer to it are in the next runs
+            if (!(errorCode = ExecuteCommand(pool->lines[line], pool->defs, pool->begin, &ctx)) && result->lost)
+                errorCode = MEMORY_ERR;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->errors[line - pool->begin] = errorCode;
+        WriteResults(pool);
+        stop = pool->stop;
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    if (stats.enabled)
+        StatsMerge(&stats, &counters);
+    ArenaFree(&scratch);
+    return NULL;
+}
+
+// returns next command from own queue or steals the last command from other queue (-1 if all the queues are empty)
+int TakeTask(pool_t *pool, int id)
+{
+    int line = -1;
+    for (int i = 0; line < 0 && i < pool->jobs; i++)
+    {
+        queue_t *queue = &pool->queues[(id + i) % pool->jobs];
+        pthread_mutex_lock(&queue->lock);
+        if (queue->head < queue->tail)
+            line = i ? queue->tasks[--queue->tail] : queue->tasks[queue->head++];
+        pthread_mutex_unlock(&queue->lock);
+    }
+    return line;
+}
+
+// writes output of finished commands in the order of lines till the first command which isn't finished (pool has to be locked)
+void WriteResults(pool_t *pool)
+{
+    for (; !pool->stop && pool->next < pool->end && pool->errors[pool->next - pool->begin] >= 0; pool->next++)
+    {
+        int index = pool->next - pool->begin;
+        if ((pool->errorCode = pool->errors[index])) // output of the next commands isn't written
+        {
+            pool->stop = true;
+            break;
+        }
+        OutputWrite(pool->out, pool->results[index].data, pool->results[index].size);
+        if (pool->next + 1 != pool->lineCount)
+            OutputChar(pool->out, '\n');
+        free(pool->results[index].data);
+        pool->results[index].data = NULL;
+    }
+}
+
+// returns set parsed from the line which argument of expression refers to (NULL if it isn't set)
+set_t *ArgumentSet(exp_t *expression, int argument, def_t *defs, int defCount)
+{
+    int line = expression->arguments[argument];
+    return line >= 0 && line < defCount ? defs[line].set : NULL;
+}
+
+// returns relation parsed from the line which argument of expression refers to (NULL if it isn't relation)
+rel_t *ArgumentRelation(exp_t *expression, int argument, def_t *defs, int defCount)
+{
+    int line = expression->arguments[argument];
+    return line >= 0 && line < defCount ? defs[line].rel : NULL;
+}
+
+// finds arguments of command and calls its function
+int __execute(context_t *ctx, exp_t *expression, def_t *defs, int defCount, arg_t *args)
+{
+    int errorCode;
+
+    // checks count of arguments and finds already parsed sets or relations which arguments refer to (by descriptor of command)
+    const command_t *command = expression->command;
+    if (command->kinds[0] == EXPRESSION) // expression is compiled, its operands are sets
+    {
+        if ((errorCode = CompileExpression(expression, defs, defCount, ctx->scratch, &args[0].program)))
+            return errorCode;
+        return command->handler(ctx, args);
+    }
+    if (expression->argumentLength != (int)strlen(command->kinds))
+        return ARGS_ERR;
+    for (int i = 0; i < expression->argumentLength; i++)
+    {
+        if (command->kinds[i] == SET ? (args[i].set = ArgumentSet(expression, i, defs, defCount)) == NULL
+                                     : (args[i].rel = ArgumentRelation(expression, i, defs, defCount)) == NULL)
+            return ARGS_ERR;
+    }
+
+    return command->handler(ctx, args); // calls the function for the specific command
+}
+
+// Function to execute one command (defs are parsed lines and kept results which command can refer to, commands only read them)
+int ExecuteCommand(string str, def_t *defs, int defCount, context_t *ctx)
+{
+    exp_t expression;            // struct to store expression
+    arg_t args[MAX_ARGUMENTS];   // sets or relations which command refers to
+    char *key = NULL;            // key of command in cache (NULL if output isn't cached)
+    size_t keyLength;
+    uint64_t start = ctx->counters != NULL ? Now(CLOCK_MONOTONIC) : 0; // beginning of command for statistics
+
+    int errorCode = 0; // error code to specify error by its code
+
+    if (ctx->result != NULL) // result gets its own memory
+        ArenaInit(&ctx->result->arena, RESULT_BLOCK);
+    if ((errorCode = StringToExpression(str, &expression))) // converts this line into expression
+        return errorCode;
+    ArenaReset(ctx->scratch); // temporaries of the previous command are not needed anymore
+
+    // the same command with the same arguments was already executed (result which is kept is always computed)
+    if (ctx->result == NULL && (key = CacheKey(&cache, &expression, ctx->scratch, &keyLength)) != NULL && CacheGet(&cache, key, keyLength, ctx->out))
+    {
+        if (ctx->counters != NULL)
+            StatsCommand(ctx->counters, expression.command, start);
+        return EXIT_SUCCESS;
+    }
+    size_t begin = ctx->out->size;
+    int flushes = ctx->out->flushes;
+
+    if ((errorCode = __execute(ctx, &expression, defs, defCount, args)))
+        return errorCode;
+
+    // output is cached only if it is whole in buffer
+    if (key != NULL && ctx->out->flushes == flushes && !ctx->out->lost)
+        CachePut(&cache, key, keyLength, ctx->out->data + begin, ctx->out->size - begin);
+    if (ctx->counters != NULL)
+        StatsCommand(ctx->counters, expression.command, start);
+    return EXIT_SUCCESS;
+}
+
 // function to convert string into Expression
 int StringToExpression(string str, exp_t *dest)
 {
-    string element; // temp string for strtok elements
-    string tempstr; // temp string for string passed as argument
+    string cursor = str + 1; // skips C
+    string element;          // start of the current element
+    int length = strlen(str);
+
+    if (length == 1)
+        return COMMAND_SYNTAX_ERR;
+    if (str[1] != ' ' || str[length - 1] == ' ')
+        return COMMAND_SYNTAX_ERR;
+
+    for (int i = 2; i < length; i++)
+        if (str[i] == ' ' && str[i - 1] == ' ')
+            return COMMAND_SYNTAX_ERR;
+
+    // the first element is some command (like minus or intersect)
+    length = NextElement(&cursor, &element);
+    if ((dest->command = FindCommand(element, length)) == NULL || dest->command->kinds == NULL) // if element is unknown command
+        return ARGS_ERR;
+
+    dest->argumentLength = 0;
+    dest->source = cursor;
+    if (dest->command->kinds[0] == EXPRESSION) // numbers in expression are its operands
+    {
+        for (; *cursor; cursor++)
+        {
+            if (*cursor < '0' || *cursor > '9' || (cursor[-1] >= '0' && cursor[-1] <= '9'))
+                continue;
+            if (dest->argumentLength == MAX_OPERANDS)
+                return ARGS_ERR;
+            dest->arguments[dest->argumentLength++] = atoi(cursor) - 1;
+        }
+    }
+    while (NextElement(&cursor, &element))
+    {
+        if (dest->argumentLength == MAX_ARGUMENTS) // if we have more than 3 elements
+            return ARGS_ERR;
+        dest->arguments[dest->argumentLength++] = atoi(element) - 1;
+    }
+
+    if (!dest->argumentLength) // if we have 0 elements
+        return ARGS_ERR;
+
+    return EXIT_SUCCESS;
+}
+// returns priority of binary operator of set expression (~ has the highest one and it is unary)
+int __priority(char operator)
+{
+    switch (operator)
+    {
+    case '~':
+        return 3;
+    case '&':
+        return 2;
+    case '|':
+    case '-':
+        return 1;
+    default: // bracket
+        return 0;
+    }
+}
+
+// compiles set expression of command into postfix order (shunting-yard algorithm), operands have to be sets
+int CompileExpression(exp_t *expression, def_t *defs, int defCount, arena_t *arena, program_t **dest)
+{
+    string source = expression->source;
+    size_t length = strlen(source);
+    program_t *program;
+    string operators; // stack of operators and brackets which are not in code yet
+    int top = 0;      // count of operators on stack
+    int depth = 0;    // count of values on stack when code is evaluated
+    int operands = 0; // count of operands in code (they are in the same order as in source)
+    int code = 0;     // count of instructions
+    bool operand = true; // true if operand (or unary operator or bracket) is expected
+
+    if ((program = ArenaAlloc(arena, sizeof(program_t))) == NULL || (program->code = ArenaAlloc(arena, length + 1)) == NULL ||
+        (operators = ArenaAlloc(arena, length + 1)) == NULL ||
+        (program->operands = ArenaAlloc(arena, (expression->argumentLength + 1) * sizeof(set_t *))) == NULL)
+        return MEMORY_ERR;
+    reset(program->depth);
+
+    for (string cursor = source; *cursor; cursor++)
+    {
+        char ch = *cursor;
+        if (ch == ' ')
+            continue;
+
+        if (ch >= '0' && ch <= '9') // operand is set from some of the previous lines
+        {
+            set_t *set;
+            if (!operand)
+                return COMMAND_SYNTAX_ERR;
+            if ((set = ArgumentSet(expression, operands, defs, defCount)) == NULL)
+                return ARGS_ERR;
+            while (cursor[1] >= '0' && cursor[1] <= '9')
+                cursor++;
+            program->operands[operands++] = set;
+            program->code[code++] = OPERAND;
+            operand = false;
+        }
+        else if (ch == '(' || ch == '~') // unary operator is applied after its operand
+        {
+            if (!operand)
+                return COMMAND_SYNTAX_ERR;
+            operators[top++] = ch;
+        }
+        else if (ch == ')')
+        {
+            if (operand)
+                return COMMAND_SYNTAX_ERR;
+            while (top && operators[top - 1] != '(')
+                program->code[code++] = operators[--top];
+            if (!top) // missing (
+                return COMMAND_SYNTAX_ERR;
+            top--;
+        }
+        else if (ch == '&' || ch == '|' || ch == '-') // operators with the same or higher priority are applied first
+        {
+            if (operand)
+                return COMMAND_SYNTAX_ERR;
+            while (top && __priority(operators[top - 1]) >= __priority(ch))
+                program->code[code++] = operators[--top];
+            operators[top++] = ch;
+            operand = true;
+        }
+        else
+            return COMMAND_SYNTAX_ERR;
+    }
+    if (operand)
+        return COMMAND_SYNTAX_ERR;
+    while (top)
+    {
+        if (operators[top - 1] == '(') // missing )
+            return COMMAND_SYNTAX_ERR;
+        program->code[code++] = operators[--top];
+    }
+    reset(program->code[code]);
+
+    // operand adds value on stack, binary operator takes 2 values and gives back 1
+    for (int i = 0; i < code; i++)
+    {
+        depth += program->code[i] == OPERAND ? 1 : program->code[i] == '~' ? 0 : -1;
+        if (depth > program->depth)
+            program->depth = depth;
+    }
+    *dest = program;
+    return EXIT_SUCCESS;
+}
+
+// sorts IDs (insertion sort for short sets, otherwise radix sort by 11 bits), returns ids or temp (with the same size) with sorted IDs
+uint32_t *__sort_ids(uint32_t *ids, uint32_t *temp, uint32_t count, uint32_t max)
+{
+    uint32_t i = 1;
+    while (i < count && ids[i - 1] <= ids[i]) // elements are often in the order of universum
+        i++;
+    if (i >= count)
+        return ids;
+    if (count < 64)
+    {
+        for (; i < count; i++)
+        {
+            uint32_t id = ids[i], j = i;
+            for (; j && ids[j - 1] > id; j--)
+                ids[j] = ids[j - 1];
+            ids[j] = id;
+        }
+        return ids;
+    }
+
+    // only digits which can be nonzero are sorted
+    for (uint32_t shift = 0; shift < 32 && max >> shift; shift += 11)
+    {
+        uint32_t offsets[(1 << 11) + 1] = {0}; // starts of digits in temp
+        for (i = 0; i < count; i++)
+            offsets[(ids[i] >> shift & ((1 << 11) - 1)) + 1]++;
+        for (i = 1; i <= (1 << 11); i++)
+            offsets[i] += offsets[i - 1];
+        for (i = 0; i < count; i++)
+            temp[offsets[ids[i] >> shift & ((1 << 11) - 1)]++] = ids[i];
+        uint32_t *swap = ids;
+        ids = temp;
+        temp = swap;
+    }
+    return ids;
+}
+
+// finds the first element which is in set twice (in the order of string), sorted are IDs of the whole set
+int __same_element(string str, const uint32_t *sorted, uint32_t count, symtab_t *universum)
+{
+    string cursor = str + 1; // skips S
+    string element;
+    int length;
+    uint8_t *seen; // flags of the first occurrences of IDs in sorted
+    uint32_t id = 0;
+
+    if ((seen = calloc(count + 1, 1)) == NULL)
+        return MEMORY_ERR;
+    while ((length = NextElement(&cursor, &element)))
+    {
+        uint32_t low = 0, high = count;
+        id = LookupElement(universum, element, length);
+        while (low < high) // the first occurrence of ID
+        {
+            uint32_t middle = low + (high - low) / 2;
+            if (sorted[middle] < id)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        if (seen[low]++)
+            break;
+    }
+    free(seen);
+    return SameElementError(universum, id, NOT_FOUND);
+}
+
+// converts string into set
+int StringToSet(string str, set_t *dest, symtab_t *universum, arena_t *arena)
+{
+    if (str[0] != SET && str[0] != UNIVERSUM) // if string is not set or universum
+        return ARGS_ERR;
+
+    string cursor = str + 1; // skips S or U
+    string element;          // start of the current element
+    int length;              // length of the current element
+    uint32_t capacity = 1;   // count of elements is at most count of spaces in the string
+    uint32_t count = 0;      // count of elements
+    uint32_t *ids;           // IDs of elements (and memory for sorting them)
+    int errorCode = 0;
+
+    for (int i = 0; str[i]; i++)
+        if (str[i] == ' ')
+            capacity++;
+
+    if ((ids = malloc(2 * capacity * sizeof(uint32_t))) == NULL) // allocates memory for IDs
+        return MEMORY_ERR;
+
+    while ((length = NextElement(&cursor, &element)))
+    {
+        if ((ids[count] = LookupElement(universum, element, length)) == NOT_FOUND) // element doesn't exist in universum
+        {
+            errorCode = ARGS_ERR;
+            break;
+        }
+        count++;
+    }
+
+    // the same elements are next to each other after sorting (they are reported before elements which don't exist)
+    uint32_t *sorted = __sort_ids(ids, ids + capacity, count, universum->count);
+    for (uint32_t i = 1; i < count; i++)
+        if (sorted[i] == sorted[i - 1])
+        {
+            errorCode = __same_element(str, sorted, count, universum);
+            break;
+        }
+    if (!errorCode)
+        errorCode = SetFromIds(sorted, count, dest, arena);
+
+    free(ids);
+    return errorCode;
+}
+
+int StringToRelation(string str, rel_t *dest, symtab_t *universum, arena_t *arena)
+{
+    if (str[0] != RELATION) // if string is not relation
+        return ARGS_ERR;
+
+    reset(dest->count); // resets relation's count of elements
+
+    int capacity = 1; // count of pairs is at most count of ( in the string
+
+    for (int i = 0; str[i]; i++)
+        if (str[i] == '(')
+            capacity++;
+
+    if ((dest->pair = ArenaAlloc(arena, capacity * sizeof(pair_t))) == NULL) // allocates memory for pairs in relation
+        return MEMORY_ERR;
+
+    string cursor = str + 1; // skips R
+    string element;          // start of the current element
+
+    // this loop separates pairs like "(a b)" into "a" and "b"
+    while (*cursor)
+    {
+        if (*cursor++ != ' ' || *cursor++ != '(')
+            return ARGS_ERR;
+        for (int counter = 0; counter < PAIR; counter++)
+        {
+            for (element = cursor; *cursor && *cursor != ' ' && *cursor != ')'; cursor++)
+                ;
+            // the first element has to end with space, the second one with )
+            if (*cursor != (counter ? ')' : ' '))
+                return ARGS_ERR;
+
+            uint32_t id = LookupElement(universum, element, cursor - element);
+            if (id == NOT_FOUND) // element doesn't exist in universum
+                return ARGS_ERR;
+            dest->pair[dest->count].elements[counter] = id;
+            cursor++;
+        }
+        dest->count++;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// the smallest container for count of values which form runs (array has 2 bytes per value, runs 4 bytes per run, bitmap 8KB)
+uint32_t __container_type(uint32_t count, uint32_t runs)
+{
+    if (2 * runs < (count <= ARRAY_MAX ? count : ARRAY_MAX)) // bitmap has the same size as the biggest array
+        return RUN_CONTAINER;
+    return count <= ARRAY_MAX ? ARRAY_CONTAINER : BITMAP_CONTAINER;
+}
+
+// fills 16-bit values after the last one in word by zeros (snapshots and comparisons don't see garbage)
+void __pad_values(uint16_t *values, uint32_t count)
+{
+    for (; count % 4; count++)
+        reset(values[count]);
+}
+
+// makes sure that builder has space for one more container with words of data
+int __builder_reserve(builder_t *builder, size_t words)
+{
+    set_t *set = &builder->set;
+
+    if (set->size == builder->capacity)
+    {
+        container_t *containers;
+        builder->capacity = builder->capacity ? 2 * builder->capacity : 16;
+        if ((containers = ArenaAlloc(builder->arena, builder->capacity * sizeof(container_t))) == NULL)
+            return MEMORY_ERR;
+        if (set->size)
+            memcpy(containers, set->containers, set->size * sizeof(container_t));
+        set->containers = containers;
+    }
+    if (builder->used + words > builder->words)
+    {
+        uint64_t *data;
+        builder->words = 2 * builder->words > builder->used + words ? 2 * builder->words : builder->used + words;
+        if ((data = ArenaAlloc(builder->arena, builder->words * sizeof(uint64_t))) == NULL)
+            return MEMORY_ERR;
+        if (builder->used)
+            memcpy(data, set->data, builder->used * sizeof(uint64_t));
+        set->data = data;
+    }
+    return EXIT_SUCCESS;
+}
+
+// adds container whose data are already written after the used words (empty container isn't added)
+void __builder_add(builder_t *builder, uint32_t key, uint32_t type, uint32_t size, uint32_t count)
+{
+    set_t *set = &builder->set;
+
+    if (!count)
+        return;
+    if (type != BITMAP_CONTAINER)
+        __pad_values((uint16_t *)(set->data + builder->used), type == ARRAY_CONTAINER ? size : 2 * size);
+    set->containers[set->size++] = (container_t){key, count, size, type, builder->used};
+    builder->used += ContainerWords(type, size);
+    set->count += count;
+}
+
+// adds copy of container
+int __builder_copy(builder_t *builder, const set_t *set, const container_t *container)
+{
+    size_t words = ContainerWords(container->type, container->size);
+
+    if (__builder_reserve(builder, words))
+        return MEMORY_ERR;
+    memcpy(builder->set.data + builder->used, set->data + container->offset, words * sizeof(uint64_t));
+    __builder_add(builder, container->key, container->type, container->size, container->count);
+    return EXIT_SUCCESS;
+}
+
+// adds chunk given by bitmap (CHUNK_WORDS words) as the smallest container
+int __builder_bits(builder_t *builder, uint32_t key, const uint64_t *bits)
+{
+    uint32_t count = kernels.popcount(bits, CHUNK_WORDS), runs = 0, n = 0;
+
+    if (!count)
+        return EXIT_SUCCESS;
+    for (size_t w = 0; w < CHUNK_WORDS; w++) // run starts at bit which is set after bit which isn't set
+        runs += Popcount64(bits[w] & ~(bits[w] << 1 | (w ? bits[w - 1] >> (WORD_BITS - 1) : 0)));
+
+    uint32_t type = __container_type(count, runs), size = type == RUN_CONTAINER ? runs : type == ARRAY_CONTAINER ? count : CHUNK_WORDS;
+    if (__builder_reserve(builder, ContainerWords(type, size)))
+        return MEMORY_ERR;
+
+    uint64_t *data = builder->set.data + builder->used;
+    uint16_t *values = (uint16_t *)data;
+    if (type == BITMAP_CONTAINER)
+        memcpy(data, bits, CHUNK_WORDS * sizeof(uint64_t));
+    else if (type == ARRAY_CONTAINER)
+    {
+        for (size_t w = 0; w < CHUNK_WORDS; w++)
+            for (uint64_t word = bits[w]; word; word &= word - 1) // goes through all the bits set in word
+                values[n++] = w * WORD_BITS + Ctz64(word);
+    }
+    else
+    {
+        uint32_t start = 0; // start of the current run
+        bool open = false;  // true if the last bit was set
+        for (uint32_t w = 0; w < CHUNK_WORDS; w++)
+            for (uint32_t bit = 0; bit < WORD_BITS; open = !open)
+            {
+                uint64_t rest = (open ? ~bits[w] : bits[w]) >> bit; // end of the current run or start of the next one
+                if (!rest)
+                    break;
+                bit += Ctz64(rest);
+                if (!open)
+                    start = w * WORD_BITS + bit;
+                else
+                {
+                    values[n++] = start;
+                    values[n++] = w * WORD_BITS + bit - 1 - start;
+                }
+            }
+        if (open) // the last run ends at the end of chunk
+        {
+            values[n++] = start;
+            values[n++] = (1 << CHUNK_BITS) - 1 - start;
+        }
+    }
+    __builder_add(builder, key, type, size, count);
+    return EXIT_SUCCESS;
+}
+
+// gives built set to dest, its buffers are copied only if dest has to be in other arena
+int __builder_set(builder_t *builder, set_t *dest, arena_t *arena)
+{
+    *dest = builder->set;
+    if (arena == builder->arena)
+        return EXIT_SUCCESS;
+    if ((dest->containers = ArenaAlloc(arena, dest->size * sizeof(container_t))) == NULL ||
+        (dest->data = ArenaAlloc(arena, builder->used * sizeof(uint64_t))) == NULL)
+        return MEMORY_ERR;
+    if (dest->size)
+    {
+        memcpy(dest->containers, builder->set.containers, dest->size * sizeof(container_t));
+        memcpy(dest->data, builder->set.data, builder->used * sizeof(uint64_t));
+    }
+    return EXIT_SUCCESS;
+}
+
+// checks if value is in container (binary search in array or in starts of runs)
+bool __container_has(const set_t *set, const container_t *container, uint16_t value)
+{
+    const uint64_t *data = set->data + container->offset;
+    const uint16_t *values = (const uint16_t *)data;
+    uint32_t step = container->type == ARRAY_CONTAINER ? 1 : 2, low = 0, high = container->size;
+
+    if (container->type == BITMAP_CONTAINER)
+        return BitsetHas(data, value);
+    while (low < high) // the first value (or start of run) bigger than value
+    {
+        uint32_t middle = low + (high - low) / 2;
+        if (values[middle * step] <= value)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (!low)
+        return false;
+    low = (low - 1) * step;
+    return step == 1 ? values[low] == value : value - values[low] <= values[low + 1];
+}
+
+// Function to convert sorted unique IDs into set, the first pass finds containers and their sizes, the second one fills them
+int SetFromIds(const uint32_t *ids, uint32_t count, set_t *dest, arena_t *arena)
+{
+    dest->count = count;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        size_t words = 0; // words of containers before the current one
+
+        reset(dest->size);
+        for (uint32_t i = 0, j; i < count; i = j)
+        {
+            uint32_t key = ids[i] >> CHUNK_BITS, runs = 1;
+            for (j = i + 1; j < count && ids[j] >> CHUNK_BITS == key; j++)
+                if (ids[j] != ids[j - 1] + 1)
+                    runs++;
+
+            uint32_t type = __container_type(j - i, runs), size = type == RUN_CONTAINER ? runs : type == ARRAY_CONTAINER ? j - i : CHUNK_WORDS;
+            if (pass)
+            {
+                uint64_t *data = dest->data + words;
+                uint16_t *values = (uint16_t *)data;
+                uint32_t n = 0;
+
+                dest->containers[dest->size] = (container_t){key, j - i, size, type, words};
+                if (type == BITMAP_CONTAINER)
+                {
+                    memset(data, 0, CHUNK_WORDS * sizeof(uint64_t));
+                    for (uint32_t k = i; k < j; k++)
+                        data[(uint16_t)ids[k] / WORD_BITS] |= (uint64_t)1 << (ids[k] % WORD_BITS);
+                }
+                else if (type == ARRAY_CONTAINER)
+                    for (uint32_t k = i; k < j; k++)
+                        values[n++] = ids[k];
+                else
+                    for (uint32_t k = i; k < j; k++)
+                    {
+                        if (k == i || ids[k] != ids[k - 1] + 1) // start of the next run
+                        {
+                            values[n++] = ids[k];
+                            reset(values[n++]);
+                        }
+                        else
+                            values[n - 1]++;
+                    }
+                if (type != BITMAP_CONTAINER)
+                    __pad_values(values, n);
+            }
+            dest->size++;
+            words += ContainerWords(type, size);
+        }
+        if (!pass && ((dest->containers = ArenaAlloc(arena, dest->size * sizeof(container_t))) == NULL ||
+                      (dest->data = ArenaAlloc(arena, words * sizeof(uint64_t))) == NULL))
+            return MEMORY_ERR;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Function to convert bitset into set (bitset has ChunkWords(words) words)
+int SetFromBits(const uint64_t *bits, size_t words, set_t *dest, arena_t *arena, arena_t *scratch)
+{
+    builder_t builder = {.arena = scratch};
+
+    for (size_t w = 0; w < words; w += CHUNK_WORDS)
+        if (__builder_bits(&builder, w / CHUNK_WORDS, bits + w))
+            return MEMORY_ERR;
+    return __builder_set(&builder, dest, arena);
+}
+
+// returns index of the first value from index from which isn't smaller than value (size if there is none), steps grow twice
+// till some value isn't smaller, then the last step is searched by halves
+uint32_t __gallop(const uint16_t *values, uint32_t size, uint32_t from, uint16_t value)
+{
+    uint32_t low = from, high = from, step = 1;
+
+    while (high < size && values[high] < value)
+    {
+        low = high + 1;
+        high += step;
+        step *= 2;
+    }
+    if (high > size)
+        high = size;
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+        if (values[middle] < value)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+// Function to combine sorted arrays of unique values (| union, & intersect, - minus) into dest, returns count of values of result.
+// If one array is GALLOP_RATIO times bigger, values of the smaller one are galloped in it and spans of the bigger one between them
+// are copied at once. Arrays of similar sizes are intersected by kernel and merged otherwise
+uint32_t __merge_arrays(const uint16_t *u, uint32_t m, const uint16_t *v, uint32_t n, char operation, uint16_t *dest)
+{
+    uint32_t count = 0, i = 0, j = 0;
+
+    // values of small array are kept if they are found (intersect) or if they aren't found (minus)
+    if ((operation == '&' && (m * GALLOP_RATIO < n || n * GALLOP_RATIO < m)) || (operation == '-' && m * GALLOP_RATIO < n))
+    {
+        bool swap = n < m;
+        const uint16_t *small = swap ? v : u, *big = swap ? u : v;
+        uint32_t smallSize = swap ? n : m, bigSize = swap ? m : n;
+        for (; i < smallSize; i++)
+        {
+            j = __gallop(big, bigSize, j, small[i]);
+            if ((j < bigSize && big[j] == small[i]) == (operation == '&'))
+                dest[count++] = small[i];
+        }
+        return count;
+    }
+    if (operation == '&')
+        return kernels.intersect(u, m, v, n, dest);
+
+    // big array is copied by spans, values of small array are inserted (union) or removed from it (minus)
+    if ((operation == '|' && (m * GALLOP_RATIO < n || n * GALLOP_RATIO < m)) || (operation == '-' && n * GALLOP_RATIO < m))
+    {
+        bool swap = operation == '|' && m < n;
+        const uint16_t *small = swap ? u : v, *big = swap ? v : u;
+        uint32_t smallSize = swap ? m : n, bigSize = swap ? n : m;
+        for (; j < smallSize; j++)
+        {
+            uint32_t next = __gallop(big, bigSize, i, small[j]);
+            memcpy(dest + count, big + i, (next - i) * sizeof(uint16_t));
+            count += next - i;
+            i = next + (next < bigSize && big[next] == small[j]);
+            if (operation == '|')
+                dest[count++] = small[j];
+        }
+        memcpy(dest + count, big + i, (bigSize - i) * sizeof(uint16_t));
+        return count + bigSize - i;
+    }
+
+    while (i < m && j < n)
+    {
+        if (u[i] < v[j])
+            dest[count++] = u[i++];
+        else if (u[i] > v[j])
+        {
+            if (operation == '|')
+                dest[count++] = v[j];
+            j++;
+        }
+        else
+        {
+            if (operation == '|')
+                dest[count++] = u[i];
+            i++;
+            j++;
+        }
+    }
+    memcpy(dest + count, u + i, (m - i) * sizeof(uint16_t));
+    count += m - i;
+    if (operation == '|')
+    {
+        memcpy(dest + count, v + j, (n - j) * sizeof(uint16_t));
+        count += n - j;
+    }
+    return count;
+}
+
+// checks if all the values of sorted array u are in sorted array v (values are galloped if v is GALLOP_RATIO times bigger)
+bool __array_subseteq(const uint16_t *u, uint32_t m, const uint16_t *v, uint32_t n)
+{
+    bool gallop = m * GALLOP_RATIO < n;
+
+    for (uint32_t i = 0, j = 0; i < m; i++, j++)
+    {
+        if (gallop)
+            j = __gallop(v, n, j, u[i]);
+        else
+            while (j < n && v[j] < u[i])
+                j++;
+        if (j == n || v[j] != u[i])
+            return false;
+    }
+    return true;
+}
+
+// combines 2 containers with the same key, arrays are merged or probed, other containers are combined as bitmaps by kernels
+int __combine(builder_t *builder, const set_t *a, const container_t *x, const set_t *b, const container_t *y, char operation, uint64_t *chunks)
+{
+    const uint16_t *u = (const uint16_t *)(a->data + x->offset), *v = (const uint16_t *)(b->data + y->offset);
+    uint32_t n = 0; // count of values of result
+
+    if (x->type == ARRAY_CONTAINER && y->type == ARRAY_CONTAINER && (operation != '|' || x->size + y->size <= ARRAY_MAX))
+    {
+        if (__builder_reserve(builder, ((operation == '|' ? x->size + y->size : x->size) + 3) / 4))
+            return MEMORY_ERR;
+        n = __merge_arrays(u, x->size, v, y->size, operation, (uint16_t *)(builder->set.data + builder->used));
+        __builder_add(builder, x->key, ARRAY_CONTAINER, n, n);
+        return EXIT_SUCCESS;
+    }
+
+    // values of array are looked up in the other container (intersect is symmetric)
+    if (operation != '|' && (x->type == ARRAY_CONTAINER || (operation == '&' && y->type == ARRAY_CONTAINER)))
+    {
+        bool swap = x->type != ARRAY_CONTAINER;
+        const container_t *array = swap ? y : x, *other = swap ? x : y;
+        const uint16_t *values = swap ? v : u;
+
+        if (__builder_reserve(builder, (array->size + 3) / 4))
+            return MEMORY_ERR;
+
+        uint16_t *result = (uint16_t *)(builder->set.data + builder->used);
+        for (uint32_t i = 0; i < array->size; i++)
+            if (__container_has(swap ? a : b, other, values[i]) == (operation == '&'))
+                result[n++] = values[i];
+        __builder_add(builder, x->key, ARRAY_CONTAINER, n, n);
+        return EXIT_SUCCESS;
+    }
+
+    ChunkBits(a, x, chunks);
+    ChunkBits(b, y, chunks + CHUNK_WORDS);
+    (operation == '|' ? kernels.or : operation == '&' ? kernels.and : kernels.andnot)(chunks, chunks, chunks + CHUNK_WORDS, CHUNK_WORDS);
+    return __builder_bits(builder, x->key, chunks);
+}
+
+// Function to combine 2 sets container by container (| union, & intersect, - minus), chunks which are only in one set are copied
+// or skipped. Result is built in scratch memory and copied into arena (if it is other one)
+int SetOperation(const set_t *a, const set_t *b, char operation, set_t *dest, arena_t *arena, arena_t *scratch)
+{
+    builder_t builder = {.arena = scratch};
+    uint64_t *chunks; // containers which are combined as bitmaps
+    int errorCode = 0;
+
+    if ((chunks = ArenaAlloc(scratch, 2 * CHUNK_WORDS * sizeof(uint64_t))) == NULL)
+        return MEMORY_ERR;
+
+    // intersect ends with any of the sets, minus ends with the first set
+    for (uint32_t i = 0, j = 0; !errorCode && (i < a->size || (operation == '|' && j < b->size)) && (operation != '&' || j < b->size);)
+    {
+        const container_t *x = i < a->size ? &a->containers[i] : NULL, *y = j < b->size ? &b->containers[j] : NULL;
+
+        if (y == NULL || (x != NULL && x->key < y->key)) // chunk is only in the first set
+        {
+            if (operation != '&')
+                errorCode = __builder_copy(&builder, a, x);
+            i++;
+        }
+        else if (x == NULL || y->key < x->key) // chunk is only in the second set
+        {
+            if (operation == '|')
+                errorCode = __builder_copy(&builder, b, y);
+            j++;
+        }
+        else
+        {
+            errorCode = __combine(&builder, a, x, b, y, operation, chunks);
+            i++;
+            j++;
+        }
+    }
+    return errorCode ? errorCode : __builder_set(&builder, dest, arena);
+}
+
+// Function to check if a is subset equal of b, values of arrays are looked up, other containers are compared as bitmaps
+bool SetSubseteq(const set_t *a, const set_t *b, uint64_t *chunks)
+{
+    if (a->count > b->count)
+        return false;
+    for (uint32_t i = 0, j = 0; i < a->size; i++)
+    {
+        const container_t *x = &a->containers[i], *y;
+        while (j < b->size && b->containers[j].key < x->key)
+            j++;
+        if (j == b->size || (y = &b->containers[j])->key != x->key || x->count > y->count)
+            return false;
+
+        if (x->type == ARRAY_CONTAINER && y->type == ARRAY_CONTAINER)
+        {
+            if (!__array_subseteq((const uint16_t *)(a->data + x->offset), x->size, (const uint16_t *)(b->data + y->offset), y->size))
+                return false;
+        }
+        else if (x->type == ARRAY_CONTAINER)
+        {
+            const uint16_t *values = (const uint16_t *)(a->data + x->offset);
+            for (uint32_t k = 0; k < x->size; k++)
+                if (!__container_has(b, y, values[k]))
+                    return false;
+        }
+        else
+        {
+            ChunkBits(a, x, chunks);
+            ChunkBits(b, y, chunks + CHUNK_WORDS);
+            if (!kernels.subseteq(chunks, chunks + CHUNK_WORDS, CHUNK_WORDS))
+                return false;
+        }
+    }
+    return true;
+}
+
+// Function to check if sets are equal, containers of the same type are compared as they are (the same values give the same container)
+bool SetEqual(const set_t *a, const set_t *b, uint64_t *chunks)
+{
+    if (a->count != b->count || a->size != b->size)
+        return false;
+    for (uint32_t i = 0; i < a->size; i++)
+    {
+        const container_t *x = &a->containers[i], *y = &b->containers[i];
+        if (x->key != y->key || x->count != y->count)
+            return false;
+
+        if (x->type == y->type)
+        {
+            if (x->size != y->size || memcmp(a->data + x->offset, b->data + y->offset, ContainerWords(x->type, x->size) * sizeof(uint64_t)))
+                return false;
+        }
+        else
+        {
+            ChunkBits(a, x, chunks);
+            ChunkBits(b, y, chunks + CHUNK_WORDS);
+            if (!kernels.equal(chunks, chunks + CHUNK_WORDS, CHUNK_WORDS))
+                return false;
+        }
+    }
+    return true;
+}
+
+// converts container into bitmap of its chunk (CHUNK_WORDS words)
+void ChunkBits(const set_t *set, const container_t *container, uint64_t *bits)
+{
+    const uint64_t *data = set->data + container->offset;
+    const uint16_t *values = (const uint16_t *)data;
+
+    if (container->type == BITMAP_CONTAINER)
+    {
+        memcpy(bits, data, CHUNK_WORDS * sizeof(uint64_t));
+        return;
+    }
+    memset(bits, 0, CHUNK_WORDS * sizeof(uint64_t));
+    if (container->type == ARRAY_CONTAINER)
+        for (uint32_t i = 0; i < container->size; i++)
+            bits[values[i] / WORD_BITS] |= (uint64_t)1 << (values[i] % WORD_BITS);
+    else
+        for (uint32_t i = 0; i < container->size; i++)
+            for (uint32_t id = values[2 * i], end = id + values[2 * i + 1]; id <= end;)
+            {
+                if (id % WORD_BITS == 0 && end - id >= WORD_BITS - 1) // whole word is in run
+                {
+                    bits[id / WORD_BITS] = UINT64_MAX;
+                    id += WORD_BITS;
+                }
+                else
+                {
+                    bits[id / WORD_BITS] |= (uint64_t)1 << (id % WORD_BITS);
+                    id++;
+                }
+            }
+}
+
+// converts set into bitset for lookups by IDs (bitset has whole chunks)
+uint64_t *SetBits(const set_t *set, size_t words, arena_t *arena)
+{
+    uint64_t *bits;
+
+    if ((bits = ArenaCalloc(arena, ChunkWords(words) * sizeof(uint64_t))) == NULL)
+        return NULL;
+    for (uint32_t i = 0; i < set->size; i++)
+        ChunkBits(set, &set->containers[i], bits + (size_t)set->containers[i].key * CHUNK_WORDS);
+    return bits;
+}
+/*
+ * Returns true if set is empty
+ *
+ */
+int Empty(context_t *ctx, arg_t *args)
+{
+    set_t *set = args[0].set;
+    OutputString(ctx->out, set->count ? _FALSE : _TRUE);
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Returns length of set elements
+ *
+ */
+int Card(context_t *ctx, arg_t *args)
+{
+    set_t *set = args[0].set;
+    OutputNumber(ctx->out, set->count);
+    return EXIT_SUCCESS;
+}
+
+// keeps set as result of command if some of the next commands refers to it (set has to be in memory of result)
+int __keep_set(context_t *ctx, set_t *set)
+{
+    if (ctx->result != NULL)
+        ctx->result->set = set;
+    return EXIT_SUCCESS;
+}
+
+// prints result of operation on 2 sets (| union, & intersect, - minus)
+int __set_operation(context_t *ctx, const set_t *a, const set_t *b, char operation)
+{
+    arena_t *arena = ctx->result != NULL ? &ctx->result->arena : ctx->scratch; // result is released with the other temporaries of command (unless it is kept)
+    set_t *result;
+    int errorCode;
+
+    if ((result = ArenaAlloc(arena, sizeof(set_t))) == NULL)
+        return MEMORY_ERR;
+    if ((errorCode = SetOperation(a, b, operation, result, arena, ctx->scratch)))
+        return errorCode;
+
+    PrintSet(ctx->out, ctx->universum, result, SET);
+    return __keep_set(ctx, result);
+}
+
+/*
+ *  prints complement of set
+ *
+ */
+int Complement(context_t *ctx, arg_t *args)
+{
+    set_t *set = args[0].set;
+    return __set_operation(ctx, ctx->universum->set, set, '-');
+}
+
+/*
+ *  prints union of 2 sets
+ *
+ */
+int Union(context_t *ctx, arg_t *args)
+{
+    set_t *set1 = args[0].set, *set2 = args[1].set;
+    return __set_operation(ctx, set1, set2, '|');
+}
+
+/*
+ *  prints intersect of 2 sets
+ *
+ */
+int Intersect(context_t *ctx, arg_t *args)
+{
+    set_t *set1 = args[0].set, *set2 = args[1].set;
+    return __set_operation(ctx, set1, set2, '&');
+}
+
+/*
+ *  prints set A minus B
+ *
+ */
+int Minus(context_t *ctx, arg_t *args)
+{
+    set_t *set1 = args[0].set, *set2 = args[1].set;
+    return __set_operation(ctx, set1, set2, '-');
+}
+
+/*
+ *  prints true if set A if subset equal of B
+ *
+ */
+int Subseteq(context_t *ctx, arg_t *args)
+{
+    set_t *subset = args[0].set, *set = args[1].set;
+    uint64_t *chunks; // containers which are compared as bitmaps
+
+    if ((chunks = ArenaAlloc(ctx->scratch, 2 * CHUNK_WORDS * sizeof(uint64_t))) == NULL)
+        return MEMORY_ERR;
+    OutputString(ctx->out, SetSubseteq(subset, set, chunks) ? _TRUE : _FALSE);
+    return EXIT_SUCCESS;
+}
+
+/*
+ *  prints true if set A if subset of B
+ *
+ */
+int Subset(context_t *ctx, arg_t *args)
+{
+    set_t *subset = args[0].set, *set = args[1].set;
+    uint64_t *chunks; // containers which are compared as bitmaps
+
+    if ((chunks = ArenaAlloc(ctx->scratch, 2 * CHUNK_WORDS * sizeof(uint64_t))) == NULL)
+        return MEMORY_ERR;
+
+    // A is a subset of B if A is subset equal of B and they are not equal (so B has more elements)
+    bool result = subset->count < set->count && SetSubseteq(subset, set, chunks);
+    OutputString(ctx->out, result ? _TRUE : _FALSE);
+    return EXIT_SUCCESS;
+}
+
+/*
+ *  prints true if sets A and B are equal
+ *
+ */
+int Equals(context_t *ctx, arg_t *args)
+{
+    set_t *set1 = args[0].set, *set2 = args[1].set;
+    uint64_t *chunks; // containers which are compared as bitmaps
+
+    if ((chunks = ArenaAlloc(ctx->scratch, 2 * CHUNK_WORDS * sizeof(uint64_t))) == NULL)
+        return MEMORY_ERR;
+    OutputString(ctx->out, SetEqual(set1, set2, chunks) ? _TRUE : _FALSE);
+    return EXIT_SUCCESS;
+}
+
+/*
+ *  prints set given by set expression like "(1 | 2) & ~3 - 4" (~ complement, & intersect, | union, - minus)
+ *
+ */
+int Eval(context_t *ctx, arg_t *args)
+{
+    program_t *program = args[0].program;
+    symtab_t *universum = ctx->universum;
+    arena_t *arena = ctx->result != NULL ? &ctx->result->arena : ctx->scratch; // result is released with the other temporaries of command (unless it is kept)
+    builder_t builder = {.arena = ctx->scratch};
+    uint64_t (*stack)[EVAL_BLOCK]; // values of block on stack
+    uint64_t *chunks;              // converted containers of operands (CHUNK_WORDS words per operand), zeros, universum and result
+    const uint64_t **words;        // the current chunk of every operand
+    uint32_t *next;                // index of the next container of every operand
+    set_t *result;
+    int operands = 0;
+    int errorCode;
+
+    for (string op = program->code; *op; op++)
+        operands += *op == OPERAND;
+    if ((stack = ArenaAlloc(ctx->scratch, program->depth * sizeof(*stack))) == NULL ||
+        (chunks = ArenaAlloc(ctx->scratch, (operands + 3) * CHUNK_WORDS * sizeof(uint64_t))) == NULL ||
+        (words = ArenaAlloc(ctx->scratch, operands * sizeof(uint64_t *))) == NULL || (next = ArenaCalloc(ctx->scratch, operands * sizeof(uint32_t))) == NULL ||
+        (result = ArenaAlloc(arena, sizeof(set_t))) == NULL)
+        return MEMORY_ERR;
+
+    uint64_t *zeros = chunks + operands * CHUNK_WORDS, *all = zeros + CHUNK_WORDS, *bits = all + CHUNK_WORDS;
+    memset(zeros, 0, CHUNK_WORDS * sizeof(uint64_t));
+
+    // chunks are evaluated one by one, every word of every operand is read once and code is applied on blocks of words
+    for (uint32_t key = 0; key < universum->set->size; key++)
+    {
+        size_t size = universum->words - (size_t)key * CHUNK_WORDS < CHUNK_WORDS ? universum->words - (size_t)key * CHUNK_WORDS : CHUNK_WORDS;
+
+        for (int i = 0; i < operands; i++) // bitmaps are used as they are, other containers are converted
+        {
+            const set_t *set = program->operands[i];
+            const container_t *container = next[i] < set->size ? &set->containers[next[i]] : NULL;
+
+            if (container == NULL || container->key != key)
+                words[i] = zeros;
+            else if (container->type == BITMAP_CONTAINER)
+                words[i] = set->data + container->offset;
+            else
+            {
+                ChunkBits(set, container, chunks + i * CHUNK_WORDS);
+                words[i] = chunks + i * CHUNK_WORDS;
+            }
+            next[i] += words[i] != zeros;
+        }
+        ChunkBits(universum->set, &universum->set->containers[key], all);
+
+        for (size_t w = 0; w < size; w += EVAL_BLOCK)
+        {
+            size_t count = size - w < EVAL_BLOCK ? size - w : EVAL_BLOCK;
+            const uint64_t **operand = words;
+            int top = -1;
+
+            for (string op = program->code; *op; op++)
+            {
+                switch (*op)
+                {
+                case OPERAND:
+                    memcpy(stack[++top], *operand++ + w, count * sizeof(uint64_t));
+                    break;
+                case '~':
+                    for (size_t i = 0; i < count; i++)
+                        stack[top][i] = ~stack[top][i];
+                    break;
+                case '&':
+                    for (size_t i = 0, j = --top; i < count; i++)
+                        stack[j][i] &= stack[j + 1][i];
+                    break;
+                case '|':
+                    for (size_t i = 0, j = --top; i < count; i++)
+                        stack[j][i] |= stack[j + 1][i];
+                    break;
+                case '-':
+                    for (size_t i = 0, j = --top; i < count; i++)
+                        stack[j][i] &= ~stack[j + 1][i];
+                    break;
+                }
+            }
+            for (size_t i = 0; i < count; i++) // complement can't add elements which are not in universum
+                bits[w + i] = stack[0][i] & all[w + i];
+        }
+        memset(bits + size, 0, (CHUNK_WORDS - size) * sizeof(uint64_t)); // the last chunk of universum can be shorter
+        if ((errorCode = __builder_bits(&builder, key, bits)))
+            return errorCode;
+    }
+    if ((errorCode = __builder_set(&builder, result, arena)))
+        return errorCode;
+
+    PrintSet(ctx->out, universum, result, SET);
+    return __keep_set(ctx, result);
+}
+
+/*
+ *  prints true if relation is reflexive
+ *
+ */
+int Reflexive(context_t *ctx, arg_t *args)
+{
+    rel_t *rel = args[0].rel;
+    uint32_t match = 0;
+    for (int i = 0; i < rel->count; i++)
+        if (rel->pair[i].elements[0] == rel->pair[i].elements[1])
+            match++;
+
+    OutputString(ctx->out, match != ctx->universum->count ? _FALSE : _TRUE);
+    return EXIT_SUCCESS;
+}
+
+// builds bit matrix of relation in scratch memory (rows is NULL if matrix would be too big, unless always is true)
+int __relation_matrix(context_t *ctx, rel_t *rel, matrix_t *dest, bool always)
+{
+    symtab_t *universum = ctx->universum;
+    uint32_t count = 0; // count of elements in relation
+
+    dest->rows = NULL;
+    if ((dest->index = ArenaAlloc(ctx->scratch, universum->count * sizeof(uint32_t))) == NULL)
+        return MEMORY_ERR;
+    memset(dest->index, 0xff, universum->count * sizeof(uint32_t)); // all the elements are NOT_FOUND
+
+    // rows and columns are given only to elements which are in relation (in the order of IDs)
+    for (int i = 0; i < rel->count; i++)
+        for (int j = 0; j < PAIR; j++)
+            dest->index[rel->pair[i].elements[j]] = 0;
+    for (uint32_t id = 0; id < universum->count; id++)
+        if (dest->index[id] != NOT_FOUND)
+            dest->index[id] = count++;
+    if ((dest->ids = ArenaAlloc(ctx->scratch, (count + 1) * sizeof(uint32_t))) == NULL)
+        return MEMORY_ERR;
+    for (uint32_t id = 0; id < universum->count; id++)
+        if (dest->index[id] != NOT_FOUND)
+            dest->ids[dest->index[id]] = id;
+
+    dest->count = count;
+    dest->words = BitsetWords(count);
+    dest->size = dest->words * WORD_BITS;
+    if (!always && (size_t)dest->size * dest->words * sizeof(uint64_t) > MATRIX_MAX_BYTES)
+        return EXIT_SUCCESS;
+    if ((dest->rows = ArenaCalloc(ctx->scratch, (size_t)dest->size * dest->words * sizeof(uint64_t) + 1)) == NULL)
+        return MEMORY_ERR;
+
+    for (int i = 0; i < rel->count; i++)
+    {
+        uint32_t row = dest->index[rel->pair[i].elements[0]];
+        uint32_t column = dest->index[rel->pair[i].elements[1]];
+        dest->rows[row * dest->words + column / WORD_BITS] |= (uint64_t)1 << (column % WORD_BITS);
+    }
+    return EXIT_SUCCESS;
+}
+
+// copies 64x64 block of matrix (rows from row, words from word) into block
+void __matrix_block(matrix_t *matrix, size_t row, size_t word, uint64_t *block)
+{
+    for (int i = 0; i < WORD_BITS; i++)
+        block[i] = matrix->rows[(row + i) * matrix->words + word];
+}
+
+// copies block back into matrix
+void __store_block(matrix_t *matrix, size_t row, size_t word, const uint64_t *block)
+{
+    for (int i = 0; i < WORD_BITS; i++)
+        matrix->rows[(row + i) * matrix->words + word] = block[i];
+}
+
+// compares pairs by the first element, then by the second one (for qsort and bsearch)
+int __compare_pairs(const void *a, const void *b)
+{
+    const uint32_t *first = ((const pair_t *)a)->elements;
+    const uint32_t *second = ((const pair_t *)b)->elements;
+    for (int i = 0; i < PAIR; i++)
+        if (first[i] != second[i])
+            return first[i] < second[i] ? -1 : 1;
+    return 0;
+}
+
+// copies pairs of relation into scratch memory and sorts them (for relations which are too big for bit matrix)
+pair_t *__sorted_pairs(context_t *ctx, rel_t *rel)
+{
+    pair_t *sorted;
+    if ((sorted = ArenaAlloc(ctx->scratch, (rel->count + 1) * sizeof(pair_t))) == NULL)
+        return NULL;
+    memcpy(sorted, rel->pair, rel->count * sizeof(pair_t));
+    qsort(sorted, rel->count, sizeof(pair_t), __compare_pairs);
+    return sorted;
+}
+
+// returns true if sorted pairs have pair (first second)
+bool __has_pair(pair_t *sorted, int count, uint32_t first, uint32_t second)
+{
+    pair_t key = {{first, second}};
+    return bsearch(&key, sorted, count, sizeof(pair_t), __compare_pairs) != NULL;
+}
+
+// returns true if relation is symmetric (antisymmetric if anti is true)
+int __symmetric(context_t *ctx, rel_t *rel, bool anti, bool *result)
+{
+    matrix_t matrix;
+    uint64_t block[WORD_BITS], mirror[WORD_BITS]; // 64x64 block and its mirror block (transposed)
+    int errorCode;
+
+    *result = true;
+    if ((errorCode = __relation_matrix(ctx, rel, &matrix, false)))
+        return errorCode;
+
+    if (matrix.rows == NULL) // looks for mirrored pair of every pair in sorted pairs
+    {
+        pair_t *sorted = __sorted_pairs(ctx, rel);
+        if (sorted == NULL)
+            return MEMORY_ERR;
+        for (int i = 0; *result && i < rel->count; i++)
+        {
+            uint32_t *pair = rel->pair[i].elements;
+            if (anti ? pair[0] != pair[1] && __has_pair(sorted, rel->count, pair[1], pair[0]) : !__has_pair(sorted, rel->count, pair[1], pair[0]))
+                *result = false;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // block (i, j) has to be the same as transposed block (j, i), antisymmetric relation can't have the same bits in them (except diagonal)
+    for (size_t i = 0; *result && i < matrix.words; i++)
+    {
+        for (size_t j = i; *result && j < matrix.words; j++)
+        {
+            __matrix_block(&matrix, i * WORD_BITS, j, block);
+            __matrix_block(&matrix, j * WORD_BITS, i, mirror);
+            Transpose64(mirror);
+            for (int k = 0; k < WORD_BITS; k++)
+            {
+                uint64_t diagonal = i == j ? (uint64_t)1 << k : 0;
+                if (anti ? (block[k] & mirror[k] & ~diagonal) : (block[k] != mirror[k]))
+                    *result = false;
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+/*
+ *  prints true if relation is symmetric
+ *
+ */
+int Symmetric(context_t *ctx, arg_t *args)
+{
+    rel_t *rel = args[0].rel;
+    bool result;
+    int errorCode = __symmetric(ctx, rel, false, &result);
+    if (!errorCode)
+        OutputString(ctx->out, result ? _TRUE : _FALSE);
+    return errorCode;
+}
+
+/*
+ *  prints true if relation is antisymmetric
+ *
+ */
+int Antisymmetric(context_t *ctx, arg_t *args)
+{
+    rel_t *rel = args[0].rel;
+    bool result;
+    int errorCode = __symmetric(ctx, rel, true, &result);
+    if (!errorCode)
+        OutputString(ctx->out, result ? _TRUE : _FALSE);
+    return errorCode;
+}
+
+/*
+ *  prints true if relation is transitive
+ *
+ */
+int Transitive(context_t *ctx, arg_t *args)
+{
+    rel_t *rel = args[0].rel;
+    matrix_t matrix;
+    bool result = true;
+    int errorCode;
+
+    if ((errorCode = __relation_matrix(ctx, rel, &matrix, false)))
+        return errorCode;
+
+    if (matrix.rows != NULL)
+    {
+        // for every pair (a b) all the pairs (b c) have to have pair (a c), so row of b is subset of row of a
+        for (uint32_t a = 0; result && a < matrix.size; a++)
+        {
+            uint64_t *row = matrix.rows + a * matrix.words;
+            for (size_t w = 0; result && w < matrix.words; w++)
+                for (uint64_t word = row[w]; result && word; word &= word - 1)
+                {
+                    size_t b = w * WORD_BITS + Ctz64(word);
+                    result = kernels.subseteq(matrix.rows + b * matrix.words, row, matrix.words);
+                }
+        }
+    }
+    else
+    {
+        pair_t *sorted = __sorted_pairs(ctx, rel);
+        if (sorted == NULL)
+            return MEMORY_ERR;
+        // pairs (b c) are next to each other in sorted pairs
+        for (int i = 0; result && i < rel->count; i++)
+        {
+            uint32_t a = sorted[i].elements[0], b = sorted[i].elements[1];
+            pair_t key = {{b, 0}};
+            int j = 0, k = rel->count; // finds the first pair (b c) by binary search
+            while (j < k)
+            {
+                int middle = j + (k - j) / 2;
+                if (__compare_pairs(sorted + middle, &key) < 0)
+                    j = middle + 1;
+                else
+                    k = middle;
+            }
+            for (; result && j < rel->count && sorted[j].elements[0] == b; j++)
+                result = __has_pair(sorted, rel->count, a, sorted[j].elements[1]);
+        }
+    }
+
+    OutputString(ctx->out, result ? _TRUE : _FALSE);
+    return EXIT_SUCCESS;
+}
+
+// finds properties of relation as mapping from set1 to set2 in one pass (sets can be NULL), elements are marked by IDs
+int __mapping(context_t *ctx, rel_t *rel, set_t *set1, set_t *set2, mapping_t *dest)
+{
+    uint8_t *seen; // SEEN_FIRST and SEEN_SECOND flags of elements
+    const uint64_t *bits1 = NULL, *bits2 = NULL; // sets as bitsets
+
+    if ((seen = ArenaCalloc(ctx->scratch, ctx->universum->count + 1)) == NULL)
+        return MEMORY_ERR;
+    if ((set1 != NULL && (bits1 = SetBits(set1, ctx->universum->words, ctx->scratch)) == NULL) ||
+        (set2 != NULL && (bits2 = SetBits(set2, ctx->universum->words, ctx->scratch)) == NULL))
+        return MEMORY_ERR;
+
+    dest->fromSets = dest->function = dest->injective = true;
+    reset(dest->images);
+    for (int i = 0; i < rel->count; i++)
+    {
+        uint32_t first = rel->pair[i].elements[0], second = rel->pair[i].elements[1];
+
+        if ((bits1 != NULL && !BitsetHas(bits1, first)) || (bits2 != NULL && !BitsetHas(bits2, second)))
+            dest->fromSets = false;
+        if (seen[first] & SEEN_FIRST) // element has more than one image
+            dest->function = false;
+        if (seen[second] & SEEN_SECOND) // element is image of more than one element
+            dest->injective = false;
+        else
+            dest->images++;
+        seen[first] |= SEEN_FIRST;
+        seen[second] |= SEEN_SECOND;
+    }
+    return EXIT_SUCCESS;
+}
+
+/*
+ *  prints true if relation is a function
+ *
+ */
+int Function(context_t *ctx, arg_t *args)
+{
+    mapping_t mapping;
+    int errorCode;
+
+    if ((errorCode = __mapping(ctx, args[0].rel, NULL, NULL, &mapping)))
+        return errorCode;
+
+    OutputString(ctx->out, mapping.function ? _TRUE : _FALSE);
+    return EXIT_SUCCESS;
+}
+
+// domain and codomain
+int __domain_codomain(context_t *ctx, rel_t *rel, int param)
+{
+    symtab_t *universum = ctx->universum;
+    uint32_t *last;       // index of the last pair with element + 1 (elements are printed at their last pairs)
+    uint64_t *bits = NULL; // elements as bitset (only if result is kept)
+    set_t *set;
+    int errorCode;
+
+    if ((last = ArenaCalloc(ctx->scratch, (universum->count + 1) * sizeof(uint32_t))) == NULL)
+        return MEMORY_ERR;
+    if (ctx->result != NULL && (bits = ArenaCalloc(ctx->scratch, ChunkWords(universum->words) * sizeof(uint64_t))) == NULL)
+        return MEMORY_ERR;
+    for (int l = 0; l < rel->count; l++)
+        last[rel->pair[l].elements[param]] = l + 1;
+
+    OutputChar(ctx->out, SET);
+    for (int l = 0; l < rel->count; l++)
+    {
+        uint32_t id = rel->pair[l].elements[param];
+        if (last[id] != (uint32_t)l + 1)
+            continue;
+        OutputChar(ctx->out, ' ');
+        OutputWrite(ctx->out, ElementName(universum, id), universum->lengths[id]);
+        if (bits != NULL)
+            bits[id / WORD_BITS] |= (uint64_t)1 << (id % WORD_BITS);
+    }
+    if (bits == NULL)
+        return EXIT_SUCCESS;
+    if ((set = ArenaAlloc(&ctx->result->arena, sizeof(set_t))) == NULL)
+        return MEMORY_ERR;
+    if ((errorCode = SetFromBits(bits, universum->words, set, &ctx->result->arena, ctx->scratch)))
+        return errorCode;
+    return __keep_set(ctx, set);
+}
+
+/*
+ *  prints set of all the first elements in relation
+ *
+ */
+int Domain(context_t *ctx, arg_t *args)
+{
+    rel_t *rel = args[0].rel;
+    return __domain_codomain(ctx, rel, 0);
+}
+
+/*
+ *  prints set of all the second elements in relation
+ *
+ */
+int Codomain(context_t *ctx, arg_t *args) // same for domain, but the second of pair
+{
+    rel_t *rel = args[0].rel;
+    return __domain_codomain(ctx, rel, 1);
+}
+
+/*
+ *  returns true if relation is Injective
+ *
+ */
+int Injective(context_t *ctx, arg_t *args)
+{
+    mapping_t mapping;
+    int errorCode;
+
+    if ((errorCode = __mapping(ctx, args[0].rel, args[1].set, args[2].set, &mapping)))
+        return errorCode;
+
+    // function from set1 to set2 which maps different elements to different images
+    OutputString(ctx->out, mapping.fromSets && mapping.function && mapping.injective ? _TRUE : _FALSE);
+    return EXIT_SUCCESS;
+}
+
+/*
+ *  returns true if relation is Surjective
+ *
+ */
+int Surjective(context_t *ctx, arg_t *args)
+{
+    set_t *set2 = args[2].set;
+    mapping_t mapping;
+    int errorCode;
+
+    if ((errorCode = __mapping(ctx, args[0].rel, args[1].set, set2, &mapping)))
+        return errorCode;
+
+    // function from set1 to set2 and every element of set2 is an image (all the images are from set2)
+    OutputString(ctx->out, mapping.fromSets && mapping.function && mapping.images == set2->count ? _TRUE : _FALSE);
+    return EXIT_SUCCESS;
+}
+
+/*
+ *  returns true if relation is Bijective
+ *
+ */
+int Bijective(context_t *ctx, arg_t *args)
+{
+    rel_t *rel = args[0].rel;
+    set_t *set1 = args[1].set, *set2 = args[2].set;
+    mapping_t mapping;
+    int errorCode;
+
+    if ((errorCode = __mapping(ctx, rel, set1, set2, &mapping)))
+        return errorCode;
+
+    // has to have same count and all first or second elements are not repeating
+    bool result = rel->count == set1->count && rel->count == set2->count;
+    OutputString(ctx->out, result && mapping.fromSets && mapping.function && mapping.injective ? _TRUE : _FALSE);
+    return EXIT_SUCCESS;
+}
+
+// prepares relation for result of command if some of the next commands refers to it (capacity is the maximal count of pairs)
+int __keep_relation(context_t *ctx, size_t capacity)
+{
+    rel_t *rel;
+
+    if (ctx->result == NULL)
+        return EXIT_SUCCESS;
+    if ((rel = ArenaAlloc(&ctx->result->arena, sizeof(rel_t))) == NULL || (rel->pair = ArenaAlloc(&ctx->result->arena, (capacity + 1) * sizeof(pair_t))) == NULL)
+        return MEMORY_ERR;
+    reset(rel->count);
+    ctx->result->rel = rel;
+    return EXIT_SUCCESS;
+}
+
+// prints one pair of relation like " (a b)" (and adds it into kept result)
+void __print_pair(context_t *ctx, uint32_t first, uint32_t second)
+{
+    symtab_t *universum = ctx->universum;
+
+    OutputWrite(ctx->out, " (", 2);
+    OutputWrite(ctx->out, ElementName(universum, first), universum->lengths[first]);
+    OutputChar(ctx->out, ' ');
+    OutputWrite(ctx->out, ElementName(universum, second), universum->lengths[second]);
+    OutputChar(ctx->out, ')');
+
+    if (ctx->result != NULL && ctx->result->rel != NULL)
+    {
+        pair_t *pair = &ctx->result->rel->pair[ctx->result->rel->count++];
+        pair->elements[0] = first;
+        pair->elements[1] = second;
+    }
+}
+
+// prints pairs of relation sorted by IDs (the same pairs next to each other are printed once)
+int __print_pairs(context_t *ctx, pair_t *pairs, int count)
+{
+    if (__keep_relation(ctx, count))
+        return MEMORY_ERR;
+
+    OutputChar(ctx->out, RELATION);
+    for (int i = 0; i < count; i++)
+        if (!i || __compare_pairs(pairs + i - 1, pairs + i))
+            __print_pair(ctx, pairs[i].elements[0], pairs[i].elements[1]);
+    return EXIT_SUCCESS;
+}
+
+// prints relation from bit matrix sorted by IDs (with pairs (a a) for all the elements of universum if reflexive is true)
+int __print_matrix(context_t *ctx, matrix_t *matrix, bool reflexive)
+{
+    symtab_t *universum = ctx->universum;
+
+    // kept result has at most all the pairs of matrix and pairs (a a)
+    if (ctx->result != NULL && __keep_relation(ctx, kernels.popcount(matrix->rows, (size_t)matrix->size * matrix->words) + universum->count))
+        return MEMORY_ERR;
+
+    OutputChar(ctx->out, RELATION);
+    for (uint32_t id = 0; id < universum->count; id++)
+    {
+        uint32_t row = matrix->index[id];
+        if (row == NOT_FOUND && reflexive) // element isn't in relation, so it has only pair (a a)
+            __print_pair(ctx, id, id);
+        if (row == NOT_FOUND)
+            continue;
+
+        uint64_t *bits = matrix->rows + (size_t)row * matrix->words;
+        if (reflexive)
+            bits[row / WORD_BITS] |= (uint64_t)1 << (row % WORD_BITS);
+        for (size_t w = 0; w < matrix->words; w++)
+            for (uint64_t word = bits[w]; word; word &= word - 1) // goes through all the bits set in row
+                __print_pair(ctx, id, matrix->ids[w * WORD_BITS + Ctz64(word)]);
+    }
+    return EXIT_SUCCESS;
+}
+
+// adds transposed matrix into matrix (block by block), so relation becomes symmetric
+void __symmetric_closure(matrix_t *matrix)
+{
+    uint64_t block[WORD_BITS], mirror[WORD_BITS];
+
+    for (size_t i = 0; i < matrix->words; i++)
+        for (size_t j = i; j < matrix->words; j++)
+        {
+            __matrix_block(matrix, i * WORD_BITS, j, block);
+            __matrix_block(matrix, j * WORD_BITS, i, mirror);
+            Transpose64(mirror);
+            for (int k = 0; k < WORD_BITS; k++)
+                block[k] |= mirror[k];
+            __store_block(matrix, i * WORD_BITS, j, block);
+            Transpose64(block);
+            __store_block(matrix, j * WORD_BITS, i, block);
+        }
+}
+
+// Warshall algorithm on bitsets, row of k is added to every row which has k (n^3 / 64 operations)
+void __transitive_closure(matrix_t *matrix)
+{
+    for (uint32_t k = 0; k < matrix->count; k++)
+    {
+        uint64_t *row = matrix->rows + (size_t)k * matrix->words;
+        uint64_t bit = (uint64_t)1 << (k % WORD_BITS);
+        for (uint32_t i = 0; i < matrix->count; i++)
+        {
+            uint64_t *other = matrix->rows + (size_t)i * matrix->words;
+            if (i != k && (other[k / WORD_BITS] & bit))
+                kernels.or(other, other, row, matrix->words);
+        }
+    }
+}
+
+/*
+ *  prints transitive closure of relation
+ *
+ */
+int ClosureTrans(context_t *ctx, arg_t *args)
+{
+    rel_t *rel = args[0].rel;
+    matrix_t matrix;
+    int errorCode;
+
+    if ((errorCode = __relation_matrix(ctx, rel, &matrix, true)))
+        return errorCode;
+    __transitive_closure(&matrix);
+    return __print_matrix(ctx, &matrix, false);
+}
+
+/*
+ *  prints reflexive closure of relation (relation with pairs (a a) for all the elements of universum)
+ *
+ */
+int ClosureRefl(context_t *ctx, arg_t *args)
+{
+    rel_t *rel = args[0].rel;
+    uint32_t count = ctx->universum->count;
+    pair_t *pairs;
+
+    if ((pairs = ArenaAlloc(ctx->scratch, (rel->count + count + 1) * sizeof(pair_t))) == NULL)
+        return MEMORY_ERR;
+    memcpy(pairs, rel->pair, rel->count * sizeof(pair_t));
+    for (uint32_t id = 0; id < count; id++)
+    {
+        pairs[rel->count + id].elements[0] = id;
+        pairs[rel->count + id].elements[1] = id;
+    }
+    qsort(pairs, rel->count + count, sizeof(pair_t), __compare_pairs);
+    return __print_pairs(ctx, pairs, rel->count + count);
+}
+
+/*
+ *  prints symmetric closure of relation
+ *
+ */
+int ClosureSym(context_t *ctx, arg_t *args)
+{
+    rel_t *rel = args[0].rel;
+    pair_t *pairs;
+
+    if ((pairs = ArenaAlloc(ctx->scratch, (2 * rel->count + 1) * sizeof(pair_t))) == NULL)
+        return MEMORY_ERR;
+    for (int i = 0; i < rel->count; i++) // every pair is added with its mirrored pair
+    {
+        pairs[2 * i] = rel->pair[i];
+        pairs[2 * i + 1].elements[0] = rel->pair[i].elements[1];
+        pairs[2 * i + 1].elements[1] = rel->pair[i].elements[0];
+    }
+    qsort(pairs, 2 * rel->count, sizeof(pair_t), __compare_pairs);
+    return __print_pairs(ctx, pairs, 2 * rel->count);
+}
+
+/*
+ *  prints equivalence closure of relation (reflexive, symmetric and transitive closure)
+ *
+ */
+int ClosureEquiv(context_t *ctx, arg_t *args)
+{
+    rel_t *rel = args[0].rel;
+    matrix_t matrix;
+    int errorCode;
+
+    if ((errorCode = __relation_matrix(ctx, rel, &matrix, true)))
+        return errorCode;
+    __symmetric_closure(&matrix);
+    __transitive_closure(&matrix);
+    return __print_matrix(ctx, &matrix, true);
+}
+
+// builds compressed sparse rows of relation (or of inverse relation) in scratch memory, rows are sorted by two counting sorts
+int __relation_csr(context_t *ctx, rel_t *rel, bool inverse, csr_t *dest)
+{
+    uint32_t count = ctx->universum->count;
+    int from = inverse ? 1 : 0; // which element of pair gives row
+    uint32_t *cursor, *order;    // next free place in row, pairs sorted by the second element
+
+    if ((dest->offsets = ArenaCalloc(ctx->scratch, (count + 1) * sizeof(uint32_t))) == NULL ||
+        (dest->targets = ArenaAlloc(ctx->scratch, (rel->count + 1) * sizeof(uint32_t))) == NULL ||
+        (cursor = ArenaCalloc(ctx->scratch, (count + 1) * sizeof(uint32_t))) == NULL ||
+        (order = ArenaAlloc(ctx->scratch, (rel->count + 1) * sizeof(uint32_t))) == NULL)
+        return MEMORY_ERR;
+
+    // sorts pairs by the second element
+    for (int i = 0; i < rel->count; i++)
+        cursor[rel->pair[i].elements[1 - from] + 1]++;
+    for (uint32_t id = 0; id < count; id++)
+        cursor[id + 1] += cursor[id];
+    for (int i = 0; i < rel->count; i++)
+        order[cursor[rel->pair[i].elements[1 - from]]++] = i;
+
+    // stable sort by the first element, so rows stay sorted
+    for (int i = 0; i < rel->count; i++)
+        dest->offsets[rel->pair[i].elements[from] + 1]++;
+    for (uint32_t id = 0; id < count; id++)
+        dest->offsets[id + 1] += dest->offsets[id];
+    memcpy(cursor, dest->offsets, (count + 1) * sizeof(uint32_t));
+    for (int i = 0; i < rel->count; i++)
+    {
+        pair_t *pair = &rel->pair[order[i]];
+        dest->targets[cursor[pair->elements[from]]++] = pair->elements[1 - from];
+    }
+    return EXIT_SUCCESS;
+}
+
+// compares IDs (for qsort)
+int __compare_ids(const void *a, const void *b)
+{
+    uint32_t first = *(const uint32_t *)a, second = *(const uint32_t *)b;
+    return first < second ? -1 : first > second;
+}
+
+// finds elements c for which there are pairs (a b) and (b c), seen[c] is set to stamp for them (returns their count)
+uint32_t __compose_row(csr_t *first, csr_t *second, uint32_t a, uint32_t *seen, uint32_t stamp, uint32_t *row)
+{
+    uint32_t found = 0;
+
+    for (uint32_t i = first->offsets[a]; i < first->offsets[a + 1]; i++)
+    {
+        uint32_t b = first->targets[i];
+        for (uint32_t j = second->offsets[b]; j < second->offsets[b + 1]; j++)
+            if (seen[second->targets[j]] != stamp)
+            {
+                seen[second->targets[j]] = stamp;
+                row[found++] = second->targets[j];
+            }
+    }
+    return found;
+}
+
+/*
+ *  prints composition of relations R1 and R2 (pairs (a c) for which there is b with (a b) in R1 and (b c) in R2)
+ *
+ */
+int Compose(context_t *ctx, arg_t *args)
+{
+    uint32_t count = ctx->universum->count;
+    csr_t first, second;
+    uint32_t *seen, *row; // the last row in which element was found (stamp of row), found elements of row
+    size_t pairs = 0;     // count of pairs of composition
+    int errorCode;
+
+    if ((errorCode = __relation_csr(ctx, args[0].rel, false, &first)) || (errorCode = __relation_csr(ctx, args[1].rel, false, &second)))
+        return errorCode;
+    if ((seen = ArenaCalloc(ctx->scratch, (count + 1) * sizeof(uint32_t))) == NULL || (row = ArenaAlloc(ctx->scratch, (count + 1) * sizeof(uint32_t))) == NULL)
+        return MEMORY_ERR;
+
+    // kept result gets exact count of pairs by join without printing (stamps of rows are 1..count, then count+1..2*count)
+    for (uint32_t a = 0; ctx->result != NULL && a < count; a++)
+        pairs += __compose_row(&first, &second, a, seen, a + 1, row);
+    if ((errorCode = __keep_relation(ctx, pairs)))
+        return errorCode;
+
+    // sparse join, rows of R2 are joined to row of R1
+    OutputChar(ctx->out, RELATION);
+    for (uint32_t a = 0; a < count; a++)
+    {
+        uint32_t found = __compose_row(&first, &second, a, seen, count + a + 1, row);
+        qsort(row, found, sizeof(uint32_t), __compare_ids);
+        for (uint32_t i = 0; i < found; i++)
+            __print_pair(ctx, a, row[i]);
+    }
+    return EXIT_SUCCESS;
+}
+
+/*
+ *  prints inverse relation (pairs (b a) for all the pairs (a b))
+ *
+ */
+int Inverse(context_t *ctx, arg_t *args)
+{
+    csr_t csr;
+    int errorCode;
+
+    if ((errorCode = __relation_csr(ctx, args[0].rel, true, &csr)) || (errorCode = __keep_relation(ctx, args[0].rel->count)))
+        return errorCode;
+
+    OutputChar(ctx->out, RELATION);
+    for (uint32_t a = 0; a < ctx->universum->count; a++)
+        for (uint32_t i = csr.offsets[a]; i < csr.offsets[a + 1]; i++)
+            __print_pair(ctx, a, csr.targets[i]);
+    return EXIT_SUCCESS;
+}
+
+/*
+ *  prints relation restricted to set (pairs (a b) for which a is in set)
+ *
+ */
+int Restrict(context_t *ctx, arg_t *args)
+{
+    const uint64_t *bits; // set as bitset
+    csr_t csr;
+    int errorCode;
+
+    if ((errorCode = __relation_csr(ctx, args[0].rel, false, &csr)) || (errorCode = __keep_relation(ctx, args[0].rel->count)))
+        return errorCode;
+    if ((bits = SetBits(args[1].set, ctx->universum->words, ctx->scratch)) == NULL)
+        return MEMORY_ERR;
+
+    OutputChar(ctx->out, RELATION);
+    for (size_t w = 0; w < ctx->universum->words; w++)
+        for (uint64_t word = bits[w]; word; word &= word - 1) // goes through all the elements of set
+        {
+            uint32_t a = w * WORD_BITS + Ctz64(word);
+            for (uint32_t i = csr.offsets[a]; i < csr.offsets[a + 1]; i++)
+                __print_pair(ctx, a, csr.targets[i]);
+        }
+    return EXIT_SUCCESS;
+}
+
+// prepares empty arena, the first block is allocated with the first allocation
+void ArenaInit(arena_t *arena, size_t blockSize)
+{
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->blockSize = blockSize;
+    reset(arena->allocated);
+}
+
+// allocates memory from arena (aligned to 8 bytes), blocks are never moved so pointers stay valid
+void *ArenaAlloc(arena_t *arena, size_t size)
+{
+    size = (size + 7) & ~(size_t)7;
 
-    int length = strlen(str);
+    // goes to the next blocks kept by ArenaReset until some of them is big enough
+    while (arena->current != NULL && arena->current->used + size > arena->current->size && arena->current->next != NULL)
+        arena->current = arena->current->next;
 
-    if (length == 1)
-        return COMMAND_SYNTAX_ERR;
-    if (str[1] != ' ' || str[length - 1] == ' ')
-        return COMMAND_SYNTAX_ERR;
+    block_t *block = arena->current;
+    if (block == NULL || block->used + size > block->size)
+    {
+        size_t blockSize = arena->blockSize > size ? arena->blockSize : size;
+        if ((block = malloc(sizeof(block_t) + blockSize)) == NULL)
+            return NULL;
+        block->size = blockSize;
+        reset(block->used);
+        reset(block->next);
+        if (arena->current == NULL)
+            arena->first = block;
+        else
+            arena->current->next = block;
+        arena->current = block;
+        arena->allocated += blockSize;
+        if (arena->blockSize < ARENA_MAX_BLOCK) // the next block is twice bigger
+            arena->blockSize *= 2;
+    }
 
-    for (int i = 2; i < length; i++)
-        if (str[i] == ' ' && str[i - 1] == ' ')
-            return COMMAND_SYNTAX_ERR;
+    void *memory = block->data + block->used;
+    block->used += size;
+    return memory;
+}
 
-    if (allocate(tempstr, length + 1)) // allocates the same size of temp string as str
-        return MEMORY_ERR;
-    strcpy(tempstr, str); // copies str into tempstr
+// allocates memory from arena and fills it with zeros
+void *ArenaCalloc(arena_t *arena, size_t size)
+{
+    void *memory = ArenaAlloc(arena, size);
+    if (memory != NULL)
+        memset(memory, 0, size);
+    return memory;
+}
 
-    element = strtok(tempstr, SPACE); // first call - we get C
-    element = strtok(NULL, SPACE);    // second call we get some command (like minus or intersect)
+// releases all the allocations at once, blocks are kept for the next allocations
+void ArenaReset(arena_t *arena)
+{
+    for (block_t *block = arena->first; block != NULL; block = block->next)
+        reset(block->used);
+    arena->current = arena->first;
+}
 
-    // if element is unknown command
-    if (!isRestricted(element))
-    {
-        free(tempstr);
-        return ARGS_ERR;
-    }
+// returns current position in arena
+mark_t ArenaMark(arena_t *arena)
+{
+    mark_t mark = {arena->current, arena->current != NULL ? arena->current->used : 0};
+    return mark;
+}
 
-    if (allocate(dest->command, strlen(element) + 1)) // allocates memory for command
-        return MEMORY_ERR;
-    strcpy(dest->command, element); // copies command into a structure
-    dest->argumentLength = 0;
-    while ((element = strtok(NULL, SPACE)) != NULL)
+// releases all the allocations made after mark (blocks are kept for the next allocations)
+void ArenaRelease(arena_t *arena, mark_t mark)
+{
+    if (mark.block == NULL) // nothing was allocated before mark
     {
-        dest->arguments[dest->argumentLength++] = atoi(element) - 1;
-        if (dest->argumentLength > 3) // if we have more than 2 elements
-        {
-            free(tempstr);
-            return ARGS_ERR;
-        }
+        ArenaReset(arena);
+        return;
     }
-    free(tempstr); // frees temp string
+    for (block_t *block = mark.block->next; block != NULL; block = block->next)
+        reset(block->used);
+    mark.block->used = mark.used;
+    arena->current = mark.block;
+}
 
-    if (!dest->argumentLength) // if we have 0 elements
+// gives all the blocks back to the system
+void ArenaFree(arena_t *arena)
+{
+    for (block_t *block = arena->first, *next; block != NULL; block = next)
     {
-        free(dest->command);
-        return ARGS_ERR;
+        next = block->next;
+        free(block);
     }
-
-    return EXIT_SUCCESS;
+    if (stats.enabled && arena->allocated)
+        StatsBytes(&stats, arena->allocated, 0);
+    arena->first = NULL;
+    arena->current = NULL;
+    reset(arena->allocated);
 }
-// converts string into set
-int StringToSet(string str, set_t *dest)
+
+// maps or reads whole input and splits it into lines
+int LoadInput(string path, input_t *dest)
 {
-    if (str[0] != SET && str[0] != UNIVERSUM) // if string is not set or universum
-    {
-        free(dest);
-        return ARGS_ERR;
-    }
-    reset(dest->count); // resets its count
+    int fd = strcmp(path, STDIN) ? open(path, O_RDONLY) : STDIN_FILENO;
 
-    string element; // variable to store return variables from strtok
-    string tempstr; // temp string to store passed string
+    if (fd < 0) // if we can't open file (wrong name or something like this)
+        return FILE_ERR;
+    int errorCode = ReadInput(fd, dest, true);
+    if (fd != STDIN_FILENO)
+        close(fd);
+    return errorCode;
+}
 
-    int errorCode = 0; // variable to specify error
-    void *error;       // variable to store pointer or an error when reallocating
+// reads input from file descriptor (file, pipe or socket) till its end, file descriptor stays opened
+int ReadInput(int fd, input_t *dest, bool map)
+{
+    struct stat info;
 
-    if (allocate(dest->elements, sizeof(string))) // allocates memory for elements
-        return MEMORY_ERR;
-    if (allocate(tempstr, strlen(str) + 1)) // allocates memory for temp string
-        return MEMORY_ERR;
+    if (fstat(fd, &info))
+        return FILE_ERR;
 
-    strcpy(tempstr, str); // copies str to tempstr
+    dest->data = NULL;
+    dest->size = info.st_size;
+    dest->mapped = false;
 
-    element = strtok(tempstr, SPACE);
+    // regular files are mapped privately, so ends of lines can be rewritten without copying the file.
+    // the rest of the last page is filled with zeros, which ends the last line (if file fills the whole page, it is read instead)
+    if (map && S_ISREG(info.st_mode) && dest->size && dest->size % sysconf(_SC_PAGESIZE))
+    {
+        dest->data = mmap(NULL, dest->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (dest->data == MAP_FAILED)
+            dest->data = NULL;
+        else
+            dest->mapped = true;
+    }
 
-    while ((element = strtok(NULL, SPACE)) != NULL)
+    // pipes, standard input and the rest of files are read by big chunks
+    if (!dest->mapped)
     {
-        if (strlen(element) > MAX_LENGTH)
+        size_t capacity = READ_CHUNK;
+        ssize_t length;
+        void *error;
+
+        if (S_ISREG(info.st_mode) && dest->size >= capacity)
+            capacity = dest->size + 1;
+        dest->size = 0;
+        if (allocate(dest->data, capacity))
+            return MEMORY_ERR;
+        while ((length = read(fd, dest->data + dest->size, capacity - dest->size - 1)) > 0)
         {
-            errorCode = ARGS_ERR;
-            break;
+            dest->size += length;
+            if (capacity - dest->size - 1 == 0) // buffer is full, it is resized twice
+            {
+                if (reallocate(error, dest->data, capacity * 2))
+                {
+                    free(dest->data);
+                    return MEMORY_ERR;
+                }
+                dest->data = error;
+                capacity *= 2;
+            }
         }
-        if (allocate(dest->elements[dest->count], strlen(element) + 1)) // allocates memory for specific element
+        if (length < 0)
         {
-            errorCode = MEMORY_ERR;
-            break;
+            free(dest->data);
+            return FILE_ERR;
         }
+        reset(dest->data[dest->size]);
+    }
 
-        strcpy(dest->elements[dest->count++], element); // copies element to an element of set
+    // splits data into lines by one pass of memchr (which is vectorised in libc)
+    int capacity = 64;
+    char *line = dest->data;
+    char *end = dest->data + dest->size;
+    void *error;
+
+    reset(dest->count);
+    if (allocate(dest->lines, capacity * sizeof(string)))
+    {
+        FreeInput(dest);
+        return MEMORY_ERR;
+    }
+    while (line < end)
+    {
+        char *newline = memchr(line, '\n', end - line);
 
-        if (element != NULL) // last element
+        if (dest->count == capacity) // array of lines is resized twice
         {
-            if (reallocate(error, dest->elements, (dest->count + 1) * sizeof(string))) // resizes memory for another element
+            if (reallocate(error, dest->lines, (capacity *= 2) * sizeof(string)))
             {
-                errorCode = MEMORY_ERR;
-                break;
+                FreeInput(dest);
+                return MEMORY_ERR;
             }
-            dest->elements = error;
+            dest->lines = error;
         }
-    }
+        dest->lines[dest->count++] = line;
 
-    free(tempstr); // frees memory
+        if (newline == NULL) // the last line without new line at the end (it is already ended by zero)
+            break;
+        reset(*newline);
+        line = newline + 1;
+    }
+    return EXIT_SUCCESS;
+}
 
-    return errorCode;
+// frees loaded input
+void FreeInput(input_t *input)
+{
+    if (input->mapped)
+        munmap(input->data, input->size);
+    else
+        free(input->data);
+    free(input->lines);
 }
 
-int StringToRelation(string str, rel_t *dest)
+// opens input for reading line by line
+int OpenStream(string path, stream_t *dest)
 {
-    if (str[0] != RELATION) // if string is not relation
+    dest->fd = strcmp(path, STDIN) ? open(path, O_RDONLY) : STDIN_FILENO;
+    if (dest->fd < 0) // if we can't open file (wrong name or something like this)
+        return FILE_ERR;
+
+    dest->capacity = READ_CHUNK;
+    reset(dest->begin);
+    reset(dest->end);
+    dest->eof = false;
+    if (allocate(dest->buffer, dest->capacity))
     {
-        free(dest);
-        return ARGS_ERR;
+        CloseStream(dest);
+        return MEMORY_ERR;
     }
+    return EXIT_SUCCESS;
+}
 
-    reset(dest->count); // resets relation's count of elements
-
-    string element;
-    string strtemp;
-
-    string *pairs_t; // variable to store pairs from relation like "a b" "c d"
-
-    int pairsCount = 0; // number of pairs
-
-    int errorCode = 0;
+// reads next line, line is valid till the next call (line is NULL at the end of input)
+int ReadLine(stream_t *stream, string *line)
+{
     void *error;
+    ssize_t length;
 
-    if (allocate(pairs_t, sizeof(string))) // allocates memory for pairs variable
-        return MEMORY_ERR;
-    if (allocate(strtemp, strlen(str) + 1))
-        return MEMORY_ERR;
-
-    strcpy(strtemp, str);
-
-    element = strtok(strtemp, REL_SPACE);
-
-    // this loop finds all the pairs from relation
-    while ((element = strtok(NULL, REL_SPACE)) != NULL)
+    for (;;)
     {
-        if (strcmp(element, SPACE))
+        char *newline = memchr(stream->buffer + stream->begin, '\n', stream->end - stream->begin);
+
+        if (newline != NULL)
         {
-            if (strlen(element) > MAX_LENGTH)
-            {
-                errorCode = ARGS_ERR;
-                break;
-            }
-            if (allocate(pairs_t[pairsCount], strlen(element) + 1))
+            *line = stream->buffer + stream->begin;
+            reset(*newline);
+            stream->begin = newline - stream->buffer + 1;
+            return EXIT_SUCCESS;
+        }
+        if (stream->eof)
+        {
+            *line = NULL;
+            if (stream->begin < stream->end) // the last line without new line at the end (there is always space for '\0' in buffer)
             {
-                errorCode = MEMORY_ERR;
-                break;
+                *line = stream->buffer + stream->begin;
+                reset(stream->buffer[stream->end]);
+                stream->begin = stream->end;
             }
-            strcpy(pairs_t[pairsCount], element);
-            pairsCount++;
+            return EXIT_SUCCESS;
+        }
 
-            if (reallocate(error, pairs_t, (pairsCount + 1) * sizeof(pairs_t)))
-            {
-                errorCode = MEMORY_ERR;
-                break;
-            }
-            pairs_t = error;
+        // moves unfinished line to the start of buffer and reads next chunk after it
+        memmove(stream->buffer, stream->buffer + stream->begin, stream->end - stream->begin);
+        stream->end -= stream->begin;
+        reset(stream->begin);
+        if (stream->capacity - stream->end - 1 < READ_CHUNK / 2) // line is too long, buffer is resized twice
+        {
+            if (reallocate(error, stream->buffer, stream->capacity * 2))
+                return MEMORY_ERR;
+            stream->buffer = error;
+            stream->capacity *= 2;
         }
+        if ((length = read(stream->fd, stream->buffer + stream->end, stream->capacity - stream->end - 1)) < 0)
+            return FILE_ERR;
+        stream->eof = !length;
+        stream->end += length;
     }
-    free(strtemp);
+}
 
-    // checks if relation doesn't have the same pair
-    if (EqualStrings(pairs_t, pairsCount))
-        errorCode = ARGS_ERR;
+// closes input opened for reading line by line
+void CloseStream(stream_t *stream)
+{
+    if (stream->fd != STDIN_FILENO)
+        close(stream->fd);
+    free(stream->buffer);
+}
 
-    if (allocate(dest->pair, sizeof(pair_t))) // allocates memory for pairs in relation
-        errorCode = MEMORY_ERR;
+// prepares buffer for output to file descriptor (or only to memory if fd is -1)
+int OutputInit(output_t *out, int fd, size_t capacity)
+{
+    out->fd = fd;
+    reset(out->size);
+    reset(out->flushes);
+    reset(out->written);
+    out->lost = false;
+    out->capacity = capacity;
+    if (allocate(out->data, out->capacity))
+        return MEMORY_ERR;
+    return EXIT_SUCCESS;
+}
 
-    if (!errorCode) // if there is no error
+// appends data into buffer, full buffer is written first (data bigger than buffer are written directly)
+void OutputWrite(output_t *out, const char *data, size_t size)
+{
+    if (out->size + size > out->capacity && out->fd < 0) // buffer in memory is resized twice
     {
-        // this loop separates pairs like "a b" into "a" and "b"
-        for (int i = 0; i < pairsCount; i++)
+        size_t capacity = out->capacity;
+        void *error;
+        while (capacity < out->size + size)
+            capacity *= 2;
+        if (reallocate(error, out->data, capacity))
         {
-            int counter = 0;
-            element = strtok(pairs_t[i], SPACE);
-            for (; element != NULL; counter++)
-            {
-                if (counter >= PAIR)
-                {
-                    errorCode = ARGS_ERR;
-                    break;
-                }
-                strcpy(dest->pair[dest->count].elements[counter], element);
-                element = strtok(NULL, SPACE);
-            }
-            if (counter == 1 || errorCode) // if in paired string we have only one element
-            {
-                errorCode = ARGS_ERR;
-                break;
-            }
-            if (reallocate(error, dest->pair, (++(dest->count) + 1) * sizeof(pair_t)))
-            {
-                errorCode = MEMORY_ERR;
-                break;
-            }
-            dest->pair = error;
+            out->lost = true;
+            return;
         }
+        out->data = error;
+        out->capacity = capacity;
     }
-
-    // frees the memory
-    for (int i = 0; i < pairsCount; i++)
-        free(pairs_t[i]);
-    free(pairs_t);
-    return errorCode;
+    if (out->size + size > out->capacity)
+    {
+        OutputFlush(out);
+        if (size > out->capacity)
+        {
+            out->written += size;
+            for (ssize_t written; size && (written = write(out->fd, data, size)) > 0; size -= written)
+                data += written;
+            return;
+        }
+    }
+    memcpy(out->data + out->size, data, size);
+    out->size += size;
 }
 
-/*
- * Returns true if set is empty
- *
- */
-int Empty(set_t *set)
+void OutputString(output_t *out, const char *str)
 {
-    printf(set->count ? _FALSE : _TRUE);
-
-    FreeSet(set);
-    return EXIT_SUCCESS;
+    OutputWrite(out, str, strlen(str));
 }
 
-/*
- * Returns length of set elements
- *
- */
-int Card(set_t *set)
+void OutputChar(output_t *out, char ch)
 {
-    printf("%d", set->count);
+    if (out->size == out->capacity)
+    {
+        OutputWrite(out, &ch, 1);
+        return;
+    }
+    out->data[out->size++] = ch;
+}
 
-    FreeSet(set);
-    return EXIT_SUCCESS;
+// appends number in decimal
+void OutputNumber(output_t *out, size_t number)
+{
+    char digits[24];
+    int length = sizeof(digits);
+    do
+        digits[--length] = '0' + number % 10;
+    while ((number /= 10));
+    OutputWrite(out, digits + length, sizeof(digits) - length);
 }
 
-/*
- *  prints complement of set
- *
- */
-int Complement(set_t *universum, set_t *set)
+// writes line with new line, long lines are written straight from input by writev together with buffer
+void OutputLine(output_t *out, const char *line)
 {
-    putchar(SET);
-    if (!set->count)
-        for (int i = 0; i < universum->count; i++)
-            printf(" %s", universum->elements[i]);
+    size_t length = strlen(line);
+    if (length < OUTPUT_DIRECT || out->fd < 0)
+    {
+        OutputWrite(out, line, length);
+        OutputChar(out, '\n');
+        return;
+    }
 
-    for (int i = 0; i < universum->count; i++)
+    out->flushes++;
+    struct iovec parts[] = {{out->data, out->size}, {(void *)line, length}, {"\n", 1}};
+    size_t left = out->size + length + 1;
+    int first = 0; // the first part which isn't written yet
+    out->written += left;
+    for (ssize_t written; left && (written = writev(out->fd, parts + first, 3 - first)) > 0; left -= written)
     {
-        for (int j = 0; j < set->count; j++)
+        // skips the parts which are already written
+        for (; first < 3 && (size_t)written >= parts[first].iov_len; first++)
+            written -= parts[first].iov_len;
+        if (first < 3)
         {
-            if (!strcmp(set->elements[j], universum->elements[i])) // strings are the same
-                break;                                             // go to next element in universum
-            if (j == (set->count - 1))                             // we went through all the elements in set
-                printf(" %s", universum->elements[i]);
+            parts[first].iov_base = (char *)parts[first].iov_base + written;
+            parts[first].iov_len -= written;
         }
     }
-    FreeSet(set);
-    return EXIT_SUCCESS;
+    reset(out->size);
 }
 
-/*
- *  prints union of 2 sets
- *
- */
-int Union(set_t *set1, set_t *set2)
+// writes the whole buffer
+void OutputFlush(output_t *out)
+{
+    if (out->fd < 0) // output is only in memory
+        return;
+    out->flushes++;
+    out->written += out->size;
+    char *data = out->data;
+    for (ssize_t written; out->size && (written = write(out->fd, data, out->size)) > 0; out->size -= written)
+        data += written;
+    reset(out->size);
+}
+
+void OutputFree(output_t *out)
 {
-    putchar(SET);
-    for (int i = 0; i < set1->count; i++)
-        printf(" %s", set1->elements[i]);
-    if (set1->count)
+    OutputFlush(out);
+    if (stats.enabled && out->written)
+        StatsBytes(&stats, 0, out->written);
+    free(out->data);
+    out->data = NULL;
+}
+
+// builds key of command in arena: index of command and its arguments (sorted for commutative command), expression without spaces.
+// Returns NULL if command can't be cached
+char *CacheKey(cache_t *cache, exp_t *expression, arena_t *arena, size_t *length)
+{
+    int header[MAX_ARGUMENTS + 2] = {expression->command - COMMANDS, expression->argumentLength};
+    size_t size = (expression->command->kinds[0] == EXPRESSION ? 2 : expression->argumentLength + 2) * sizeof(int);
+    char *key;
+
+    for (int i = 0; i < expression->argumentLength; i++)
+        if (expression->arguments[i] >= cache->lines)
+            return NULL;
+    if ((key = ArenaAlloc(arena, size + strlen(expression->source) + 1)) == NULL)
+        return NULL;
+    if (expression->command->kinds[0] != EXPRESSION)
     {
-        for (int i = 0; i < set2->count; i++)
+        memcpy(header + 2, expression->arguments, expression->argumentLength * sizeof(int));
+        if (expression->command->commutative && expression->argumentLength == 2 && header[2] > header[3])
         {
-            for (int j = 0; j < set1->count; j++)
-            {
-                if (!strcmp(set1->elements[j], set2->elements[i]))
-                {
-                    break;
-                }
-                if ((set1->count - 1) == j)
-                {
-                    printf(" %s", set2->elements[i]);
-                }
-            }
+            header[2] = expression->arguments[1];
+            header[3] = expression->arguments[0];
         }
     }
-    else
-        for (int i = 0; i < set2->count; i++)
-            printf(" %s", set2->elements[i]);
-
-    FreeSet(set1);
-    FreeSet(set2);
-    return EXIT_SUCCESS;
-}
+    memcpy(key, header, size);
 
-/*
- *  prints intersect of 2 sets
- *
- */
-int Intersect(set_t *set1, set_t *set2)
-{
-    putchar(SET);
-    for (int i = 0; i < set1->count; i++)
-        for (int j = 0; j < set2->count; j++)
-            if (!strcmp(set1->elements[i], set2->elements[j]))
-                printf(" %s", set1->elements[i]);
-    FreeSet(set1);
-    FreeSet(set2);
-    return EXIT_SUCCESS;
+    *length = size;
+    for (string ch = expression->source; expression->command->kinds[0] == EXPRESSION && *ch; ch++)
+        if (*ch != ' ')
+            key[(*length)++] = *ch;
+    return key;
 }
 
-/*
- *  prints set A minus B
- *
- */
-int Minus(set_t *set1, set_t *set2)
+// returns entry with key or empty entry where it belongs (cache has to be locked)
+entry_t *__cache_entry(cache_t *cache, uint32_t hash, const char *key, size_t length)
 {
-    putchar(SET);
-    for (int i = 0; i < set1->count; i++)
+    for (size_t slot = hash & cache->mask;; slot = (slot + 1) & cache->mask)
     {
-        bool flag = false;
-        for (int j = 0; j < set2->count; j++)
-            if ((flag = !strcmp(set1->elements[i], set2->elements[j])))
-                break;
-        if (!flag)
-            printf(" %s", set1->elements[i]);
+        entry_t *entry = &cache->entries[slot];
+        if (entry->key == NULL || (entry->hash == hash && entry->keyLength == length && !memcmp(entry->key, key, length)))
+            return entry;
     }
-    FreeSet(set1);
-    FreeSet(set2);
-    return EXIT_SUCCESS;
 }
 
-/*
- *  prints true if set A if subset equal of B
- *
- */
-int Subseteq(set_t *subset, set_t *set)
+// writes cached output of command into out, returns false if command isn't in cache
+bool CacheGet(cache_t *cache, const char *key, size_t length, output_t *out)
 {
-    if (set->count == 0)
+    uint32_t hash = HashString(key, length);
+    entry_t *entry = NULL;
+    char *data = NULL;
+    size_t size = 0;
+
+    pthread_mutex_lock(&cache->lock);
+    cache->lookups++;
+    if (cache->entries != NULL && (entry = __cache_entry(cache, hash, key, length))->key != NULL)
     {
-        printf(subset->count == set->count ? _TRUE : _FALSE);
-
-        FreeSet(subset);
-        FreeSet(set);
-        return EXIT_SUCCESS;
+        cache->hits++;
+        data = entry->data; // outputs are never moved, so they can be written without lock
+        size = entry->size;
     }
-    for (int i = 0; i < subset->count; i++)
-        for (int j = 0; j < set->count; j++)
-        {
-            if (!strcmp(set->elements[j], subset->elements[i])) // are equal
-                break;
-            if (j == (set->count - 1))
-            {
-                printf(_FALSE);
-                FreeSet(subset);
-                FreeSet(set);
-                return EXIT_SUCCESS;
-            }
-        }
-    printf(_TRUE);
-    FreeSet(subset);
-    FreeSet(set);
-    return EXIT_SUCCESS;
+    pthread_mutex_unlock(&cache->lock);
+
+    if (data == NULL)
+        return false;
+    OutputWrite(out, data, size);
+    return true;
 }
 
-/*
- *  prints true if set A if subset of B
- *
- */
-int Subset(set_t *subset, set_t *set)
+// keeps output of command in cache (if cache isn't full), hash table is resized twice when it is half full
+void CachePut(cache_t *cache, const char *key, size_t length, const char *data, size_t size)
 {
-    if (subset->count == set->count)
+    uint32_t hash = HashString(key, length);
+
+    pthread_mutex_lock(&cache->lock);
+    if (cache->bytes + size + length > CACHE_MAX_BYTES)
     {
-        printf(_FALSE);
-        FreeSet(subset);
-        FreeSet(set);
-        return EXIT_SUCCESS;
+        pthread_mutex_unlock(&cache->lock);
+        return;
     }
-    if (set->count == 0)
+    if (cache->entries == NULL || (cache->count + 1) * 2 > cache->mask + 1)
     {
-        printf(_FALSE);
-        FreeSet(subset);
-        FreeSet(set);
-        return EXIT_SUCCESS;
+        size_t slots = cache->entries == NULL ? CACHE_SLOTS : (cache->mask + 1) * 2;
+        entry_t *entries = cache->entries, *table;
+        if ((table = calloc(slots, sizeof(entry_t))) == NULL)
+        {
+            pthread_mutex_unlock(&cache->lock);
+            return;
+        }
+        size_t old = entries != NULL ? cache->mask + 1 : 0;
+        cache->entries = table;
+        cache->mask = slots - 1;
+        for (size_t i = 0; i < old; i++)
+            if (entries[i].key != NULL)
+                *__cache_entry(cache, entries[i].hash, entries[i].key, entries[i].keyLength) = entries[i];
+        free(entries);
     }
-    for (int i = 0; i < subset->count; i++)
+
+    entry_t *entry = __cache_entry(cache, hash, key, length);
+    if (entry->key == NULL) // the same command could be executed by other thread meanwhile
     {
-        for (int j = 0; j < set->count; j++)
+        char *copy;
+        if ((copy = ArenaAlloc(&cache->arena, length + size + 1)) != NULL)
         {
-            if (!strcmp(set->elements[j], subset->elements[i])) // are equal
-                break;
-            if (j == (set->count - 1))
-            {
-                printf(_FALSE);
-                FreeSet(subset);
-                FreeSet(set);
-                return EXIT_SUCCESS;
-            }
+            memcpy(copy, key, length);
+            memcpy(copy + length, data, size);
+            *entry = (entry_t){hash, copy, length, copy + length, size};
+            cache->count++;
+            cache->bytes += length + size;
         }
     }
-    printf(_TRUE);
-    FreeSet(subset);
-    FreeSet(set);
-    return EXIT_SUCCESS;
+    pthread_mutex_unlock(&cache->lock);
 }
 
-/*
- *  prints true if sets A and B are equal
- *
- */
-int Equals(set_t *set1, set_t *set2)
+// prints hit rate of cache to standard error output
+void CacheStats(cache_t *cache)
 {
-    if (!(set1->count == set2->count))
+    fprintf(stderr, "cache: %zu lookups, %zu hits (%.1f%%), %zu entries, %zu bytes\n", cache->lookups, cache->hits,
+            cache->lookups ? 100.0 * cache->hits / cache->lookups : 0.0, cache->count, cache->bytes);
+}
+
+void CacheFree(cache_t *cache)
+{
+    free(cache->entries);
+    cache->entries = NULL;
+    ArenaFree(&cache->arena);
+}
+
+// returns time of clock in nanoseconds (CLOCK_MONOTONIC is read without system call)
+uint64_t Now(clockid_t clock)
+{
+    struct timespec time;
+    clock_gettime(clock, &time);
+    return time.tv_sec * 1000000000ull + time.tv_nsec;
+}
+
+void StatsStart(stats_t *stats)
+{
+    if (!stats->enabled)
+        return;
+    stats->phase = LOAD_PHASE;
+    stats->wallMark = Now(CLOCK_MONOTONIC);
+    stats->cpuMark = Now(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+// adds time since the last switch to current phase and switches to phase (nothing is measured if phase doesn't change)
+void StatsPhase(stats_t *stats, int phase)
+{
+    if (!stats->enabled || stats->phase == phase)
+        return;
+    uint64_t wall = Now(CLOCK_MONOTONIC), cpu = Now(CLOCK_PROCESS_CPUTIME_ID);
+    stats->wall[stats->phase] += wall - stats->wallMark;
+    stats->cpu[stats->phase] += cpu - stats->cpuMark;
+    stats->wallMark = wall;
+    stats->cpuMark = cpu;
+    stats->phase = phase;
+}
+
+counters_t *StatsCounters(stats_t *stats)
+{
+    return stats->enabled ? &stats->counters : NULL;
+}
+
+// counts command which began at start, its latency goes to bucket of the highest bit of nanoseconds
+void StatsCommand(counters_t *counters, const command_t *command, uint64_t start)
+{
+    uint64_t time = Now(CLOCK_MONOTONIC) - start;
+    int index = command - COMMANDS;
+    int bucket = 0;
+
+    while (bucket < HISTOGRAM_BUCKETS - 1 && time >> (bucket + 1))
+        bucket++;
+    counters->count[index]++;
+    counters->nanoseconds[index] += time;
+    counters->histogram[index][bucket]++;
+}
+
+void StatsMerge(stats_t *stats, const counters_t *counters)
+{
+    pthread_mutex_lock(&stats->lock);
+    for (int i = 0; i < COMMAND_COUNT; i++)
     {
-        printf(_FALSE);
-        FreeSet(set1);
-        FreeSet(set2);
-        return EXIT_SUCCESS;
+        stats->counters.count[i] += counters->count[i];
+        stats->counters.nanoseconds[i] += counters->nanoseconds[i];
+        for (int j = 0; j < HISTOGRAM_BUCKETS; j++)
+            stats->counters.histogram[i][j] += counters->histogram[i][j];
+    }
+    pthread_mutex_unlock(&stats->lock);
+}
+
+void StatsBytes(stats_t *stats, size_t allocated, size_t written)
+{
+    pthread_mutex_lock(&stats->lock);
+    stats->allocated += allocated;
+    stats->written += written;
+    pthread_mutex_unlock(&stats->lock);
+}
+
+// Function to print statistics of run: wall and CPU time of phases, count, total time and histogram of latencies of every executed
+// command kind, bytes allocated by arenas, peak RSS, bytes of output and hit rate of cache. They are printed as table to standard
+// error output or as JSON into file (histogram is list of pairs of the lowest latency of bucket in ns and count of commands)
+int StatsPrint(stats_t *stats, cache_t *cache, string path)
+{
+    FILE *file = stderr;
+    struct rusage usage;
+    bool json = path != NULL;
+
+    if (json && (file = fopen(path, "w")) == NULL)
+        return FILE_ERR;
+    StatsPhase(stats, PHASE_COUNT); // the last phase ends (nothing is measured after it)
+    getrusage(RUSAGE_SELF, &usage);
+
+    fprintf(file, json ? "{\n  \"phases\": [" : "phase           wall_ms      cpu_ms\n");
+    for (int i = 0, rows = 0; i < PHASE_COUNT; i++)
+    {
+        if (!stats->wall[i] && !stats->cpu[i])
+            continue;
+        if (json)
+            fprintf(file, "%s\n    {\"phase\": \"%s\", \"wall_ns\": %llu, \"cpu_ns\": %llu}", rows++ ? "," : "", PHASE_NAMES[i],
+                    (unsigned long long)stats->wall[i], (unsigned long long)stats->cpu[i]);
+        else
+            fprintf(file, "%-12s %10.3f  %10.3f\n", PHASE_NAMES[i], stats->wall[i] / 1e6, stats->cpu[i] / 1e6);
     }
-    for (int i = 0; i < set1->count; i++)
+
+    fprintf(file, json ? "\n  ],\n  \"commands\": [" : "command         count    total_ms     mean_us  histogram (<ns:count)\n");
+    for (int i = 0, rows = 0; i < COMMAND_COUNT; i++)
     {
-        for (int j = 0; j < set2->count; j++)
+        const counters_t *counters = &stats->counters;
+        if (!counters->count[i])
+            continue;
+        if (json)
+            fprintf(file, "%s\n    {\"command\": \"%s\", \"count\": %llu, \"total_ns\": %llu, \"histogram\": [", rows++ ? "," : "",
+                    COMMANDS[i].name, (unsigned long long)counters->count[i], (unsigned long long)counters->nanoseconds[i]);
+        else
+            fprintf(file, "%-13s %7llu  %10.3f  %10.3f ", COMMANDS[i].name, (unsigned long long)counters->count[i], counters->nanoseconds[i] / 1e6,
+                    counters->nanoseconds[i] / 1e3 / counters->count[i]);
+        for (int j = 0, buckets = 0; j < HISTOGRAM_BUCKETS; j++)
         {
-            if (!strcmp(set1->elements[i], set2->elements[j])) // are equal
-                break;
-            if (j == (set2->count - 1)) // last element of set2
-            {
-                printf(_FALSE);
-                FreeSet(set1);
-                FreeSet(set2);
-                return EXIT_SUCCESS;
-            }
+            if (!counters->histogram[i][j])
+                continue;
+            if (json)
+                fprintf(file, "%s[%llu, %llu]", buckets++ ? ", " : "", j ? 1ull << j : 0ull, (unsigned long long)counters->histogram[i][j]);
+            else if (j == HISTOGRAM_BUCKETS - 1) // the last bucket has no upper bound
+                fprintf(file, " >=%llu:%llu", 1ull << j, (unsigned long long)counters->histogram[i][j]);
+            else
+                fprintf(file, " <%llu:%llu", 2ull << j, (unsigned long long)counters->histogram[i][j]);
         }
+        fprintf(file, json ? "]}" : "\n");
     }
-    printf(_TRUE);
-    FreeSet(set1);
-    FreeSet(set2);
+
+    // ru_maxrss is in kilobytes on Linux
+    if (json)
+        fprintf(file, "\n  ],\n  \"allocated_bytes\": %zu,\n  \"peak_rss_kb\": %ld,\n  \"output_bytes\": %zu,\n  \"cache_lookups\": %zu,\n"
+                      "  \"cache_hits\": %zu\n}\n",
+                stats->allocated, (long)usage.ru_maxrss, stats->written, cache->lookups, cache->hits);
+    else
+        fprintf(file, "memory: %zu bytes allocated by arenas, peak RSS %ld KB, %zu bytes of output, %zu of %zu commands from cache\n",
+                stats->allocated, (long)usage.ru_maxrss, stats->written, cache->hits, cache->lookups);
+
+    if (json && fclose(file))
+        return FILE_ERR;
     return EXIT_SUCCESS;
 }
 
-/*
- *  prints true if relation is reflexive
- *
- */
-int Reflexive(rel_t *rel, set_t *universum)
+// finds next element separated by spaces, returns its length (0 if there is no element)
+int NextElement(string *cursor, string *element)
 {
-    int match = 0;
-    for (int i = 0; i < rel->count; i++)
-        if (!strcmp(rel->pair[i].elements[0], rel->pair[i].elements[1]))
-            match++;
-
-    printf(match != universum->count ? _FALSE : _TRUE);
-
-    FreeRelation(rel);
-    return EXIT_SUCCESS;
+    while (**cursor == ' ')
+        (*cursor)++;
+    *element = *cursor;
+    while (**cursor && **cursor != ' ')
+        (*cursor)++;
+    return *cursor - *element;
 }
 
-/*
- *  prints true if relation is symmetric
- *
- */
-int Symmetric(rel_t *rel)
+// returns SAME_ELEMENT_ERR if relation has 2 same pairs (pairs are found by hash table, so it takes linear time)
+int UniquePairs(symtab_t *universum, rel_t *rel, arena_t *arena)
 {
-    int control = 0;
-    for (int i = 0; i < rel->count; i++)
+    uint32_t *slots; // indexes of pairs + 1 (0 is empty slot)
+    uint32_t mask;   // size of hash table - 1
+
+    int errorCode = EXIT_SUCCESS;
+
+    // hash table is at least twice as big as count of pairs (size is a power of 2)
+    for (mask = 1; mask < (uint32_t)rel->count * 2; mask <<= 1)
+        ;
+    mark_t mark = ArenaMark(arena); // hash table is needed only here
+    if ((slots = ArenaCalloc(arena, mask * sizeof(uint32_t))) == NULL)
+        return MEMORY_ERR;
+    mask--;
+
+    for (int i = 0; !errorCode && i < rel->count; i++)
     {
-        for (int l = 0; l < rel->count; l++)
+        uint32_t *pair = rel->pair[i].elements;
+        uint32_t slot = (pair[0] * 2654435761u ^ pair[1] * 2246822519u) & mask;
+        for (; slots[slot]; slot = (slot + 1) & mask)
         {
-            if ((!strcmp(rel->pair[i].elements[0], rel->pair[l].elements[1])) && (!strcmp(rel->pair[i].elements[1], rel->pair[l].elements[0])))
+            uint32_t *other = rel->pair[slots[slot] - 1].elements;
+            if (other[0] == pair[0] && other[1] == pair[1]) // relation has 2 same pairs
             {
-                break; // found a matching symmetric element
+                errorCode = SameElementError(universum, pair[0], pair[1]);
+                break;
             }
-            else if (l == rel->count - 1) // the end of relation, haven't found its symmetric match
-                control = 1;
-        }
-        if (control)
-        {
-            printf(_FALSE);
-            break;
         }
+        slots[slot] = i + 1;
     }
-    if (!control)
-        printf(_TRUE);
 
-    FreeRelation(rel);
-    return EXIT_SUCCESS;
+    ArenaRelease(arena, mark);
+    return errorCode;
 }
 
-/*
- *  prints true if relation is antisymmetric
- *
- */
-int Antisymmetric(rel_t *rel)
+// remembers element which is in set, relation or universum twice (pair, if second isn't NOT_FOUND) and returns SAME_ELEMENT_ERR
+int SameElementError(symtab_t *universum, uint32_t id, uint32_t second)
 {
+    string first = ElementName(universum, id);
+    size_t length = strlen(first) + 1;
 
-    for (int i = 0; i < rel->count; i++)
-    {
-        for (int j = i + 1; j < rel->count; j++)
-        {
-            if (!strcmp(rel->pair[i].elements[0], rel->pair[j].elements[1]) && !strcmp(rel->pair[i].elements[1], rel->pair[j].elements[0]))
-            {
-                printf(_FALSE);
-                FreeRelation(rel);
-                return EXIT_SUCCESS;
-            }
-        }
-    }
-    printf(_TRUE);
-    FreeRelation(rel);
-    return EXIT_SUCCESS;
+    if (second != NOT_FOUND) // pair is printed like (a b)
+        length += strlen(ElementName(universum, second)) + 3;
+
+    int errorCode = SAME_ELEMENT_ERR;
+    pthread_mutex_lock(&errorLock);
+    free(errorInfo.element);
+    if ((errorInfo.element = malloc(length)) == NULL)
+        errorCode = MEMORY_ERR;
+    else if (second != NOT_FOUND)
+        sprintf(errorInfo.element, "(%s %s)", first, ElementName(universum, second));
+    else
+        strcpy(errorInfo.element, first);
+    pthread_mutex_unlock(&errorLock);
+    return errorCode;
 }
 
-/*
- *  prints true if relation is transitive
- *
- */
-int Transitive(rel_t *rel)
+// fills slots of perfect hash by indexes of restricted words, every word has to have its own slot (otherwise FindCommand
+// wouldn't find one of them and it could be used as element)
+int InitCommands(void)
 {
-    for (int i = 0; i < rel->count; i++)
+    for (int i = 0; i < COMMAND_COUNT; i++)
     {
-        for (int j = 0; j < rel->count; j++)
+        const char *name = COMMANDS[i].name;
+        uint8_t *slot = &commandIndex[CommandHash(name, (int)strlen(name))];
+        if (*slot)
         {
-            if (i != j) // are not two same pairs
-            {
-                if (!strcmp(rel->pair[i].elements[1], rel->pair[j].elements[0]))
-                {
-                    for (int k = 0; k < rel->count; k++)
-                    {
-                        if (!strcmp(rel->pair[i].elements[0], rel->pair[k].elements[0])     // first elements of pairs are the same
-                            && !strcmp(rel->pair[j].elements[1], rel->pair[k].elements[1])) // second elments of pairs are the same
-                            break;
-                        if ((rel->count - 1) == k) // we are at the last pair of relation and havent found the same as we created
-                        {
-                            printf(_FALSE);
-                            FreeRelation(rel);
-                            return EXIT_SUCCESS;
-                        }
-                    }
-                }
-            }
+            fprintf(stderr, "Restricted words %s and %s have the same slot of CommandHash", COMMANDS[*slot - 1].name, name);
+            return EXIT_FAILURE;
         }
+        *slot = i + 1;
     }
-    printf(_TRUE);
-    FreeRelation(rel);
     return EXIT_SUCCESS;
 }
 
-/*
- *  prints true if relation is a function
- *
- */
-int Function(rel_t *rel)
+// returns descriptor of restricted word (command, true or false) in O(1) or NULL if str isn't restricted word
+const command_t *FindCommand(const char *str, int length)
 {
-    for (int i = 0; i < rel->count; i++)
-    {
-        for (int j = i + 1; j < rel->count; j++)
-        {
-            if (!strcmp(rel->pair[i].elements[0], rel->pair[j].elements[0]) && strcmp(rel->pair[i].elements[1], rel->pair[j].elements[1]))
-            {
-                printf(_FALSE);
-                FreeRelation(rel);
-                return EXIT_SUCCESS;
-            }
-        }
-    }
-    printf(_TRUE);
-    FreeRelation(rel);
-    return EXIT_SUCCESS;
+    if (length == 0)
+        return NULL;
+    int index = commandIndex[CommandHash(str, length)]; // the only restricted word which can have this name
+    if (!index)
+        return NULL;
+    const command_t *command = &COMMANDS[index - 1];
+    if (strncmp(command->name, str, length) || command->name[length] != '\0')
+        return NULL;
+    return command;
 }
 
-// domain and codomain
-int __domain_codomain(rel_t *rel, int param)
+// FNV-1a hash of string
+uint32_t HashString(const char *str, int length)
 {
-    string *elements;
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < length; i++)
+        hash = (hash ^ (unsigned char)str[i]) * 16777619u;
+    return hash;
+}
 
-    if (allocate(elements, sizeof(string) * rel->count))
+// returns ID of element in universum or NOT_FOUND if element isn't in universum
+uint32_t LookupElement(symtab_t *universum, const char *str, int length)
+{
+    for (uint32_t slot = HashString(str, length) & universum->mask; universum->slots[slot]; slot = (slot + 1) & universum->mask)
     {
-        return MEMORY_ERR;
+        string name = ElementName(universum, universum->slots[slot] - 1);
+        if (!strncmp(name, str, length) && name[length] == '\0')
+            return universum->slots[slot] - 1;
     }
+    return NOT_FOUND;
+}
 
-    putchar(SET);
-    for (int i = 0; i < rel->count; i++)
-    {
-        if (allocate(elements[i], strlen(rel->pair[i].elements[param]) + 1))
-            return MEMORY_ERR;
-        strcpy(elements[i], rel->pair[i].elements[param]);
-    }
-    for (int l = 0; l < rel->count; l++)
-    {
-        bool found = false;
-        for (int k = l + 1; k < rel->count; k++)
-            if ((found = !strcmp(elements[l], elements[k])))
-                break;
+// portable count of bits in a word and index of the lowest bit set in a word
+#ifndef __GNUC__
+size_t Ctz64(uint64_t word)
+{
+    size_t count = 0;
+    for (; !(word & 1); word >>= 1)
+        count++;
+    return count;
+}
 
-        if (!found)
-            printf(" %s", elements[l]);
-    }
+size_t Popcount64(uint64_t word)
+{
+    word = word - ((word >> 1) & 0x5555555555555555u);
+    word = (word & 0x3333333333333333u) + ((word >> 2) & 0x3333333333333333u);
+    word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0Fu;
+    return (word * 0x0101010101010101u) >> 56;
+}
+#endif
 
-    for (int i = 0; i < rel->count; i++)
-        free(elements[i]);
-    free(elements);
+// portable scalar kernels
 
-    FreeRelation(rel);
-    return EXIT_SUCCESS;
+void ScalarOr(uint64_t *dest, const uint64_t *a, const uint64_t *b, size_t words)
+{
+    for (size_t i = 0; i < words; i++)
+        dest[i] = a[i] | b[i];
 }
 
-/*
- *  prints set of all the first elements in relation
- *
- */
-int Domain(rel_t *rel)
+void ScalarAnd(uint64_t *dest, const uint64_t *a, const uint64_t *b, size_t words)
 {
-    return __domain_codomain(rel, 0);
+    for (size_t i = 0; i < words; i++)
+        dest[i] = a[i] & b[i];
 }
 
-/*
- *  prints set of all the second elements in relation
- *
- */
-int Codomain(rel_t *rel) // same for domain, but the second of pair
+void ScalarAndnot(uint64_t *dest, const uint64_t *a, const uint64_t *b, size_t words)
 {
-    return __domain_codomain(rel, 1);
+    for (size_t i = 0; i < words; i++)
+        dest[i] = a[i] & ~b[i];
 }
 
-/*
- *  returns true if relation is Inejctive
- *
- */
-int Injective(rel_t *rel, set_t *set1, set_t *set2) //
+size_t ScalarPopcount(const uint64_t *a, size_t words)
 {
-    if (rel->count != 0) // we solve problem with having empty set but rel with elements
-    {
-        if (set1->count == 0)
-        {
-            printf(_FALSE);
-            FreeRelation(rel);
-            FreeSet(set1);
-            FreeSet(set2);
-            return EXIT_SUCCESS;
-        }
-        if (set2->count == 0)
-        {
-            printf(_FALSE);
-            FreeRelation(rel);
-            FreeSet(set1);
-            FreeSet(set2);
-            return EXIT_SUCCESS;
-        }
-    }
+    size_t count = 0;
+    for (size_t i = 0; i < words; i++)
+        count += Popcount64(a[i]);
+    return count;
+}
 
-    // all the first elements in rel are from set1
-    for (int i = 0; i < rel->count; i++)
-        for (int j = 0; j < set1->count; j++)
-        {
-            if (!strcmp(rel->pair[i].elements[0], set1->elements[j]))
-                break;
-            if ((set1->count - 1) == j)
-            {
-                printf(_FALSE);
-                FreeRelation(rel);
-                FreeSet(set1);
-                FreeSet(set2);
-                return EXIT_SUCCESS;
-            }
-        }
+bool ScalarZero(const uint64_t *a, size_t words)
+{
+    for (size_t i = 0; i < words; i++)
+        if (a[i])
+            return false;
+    return true;
+}
 
-    // all the second elements in rel are from set2
+bool ScalarSubseteq(const uint64_t *a, const uint64_t *b, size_t words)
+{
+    for (size_t i = 0; i < words; i++)
+        if (a[i] & ~b[i])
+            return false;
+    return true;
+}
 
-    for (int i = 0; i < rel->count; i++)
+bool ScalarEqual(const uint64_t *a, const uint64_t *b, size_t words)
+{
+    for (size_t i = 0; i < words; i++)
+        if (a[i] != b[i])
+            return false;
+    return true;
+}
+
+// merges sorted arrays of unique values, the smaller value moves on (both move on if they are equal)
+uint32_t ScalarIntersect(const uint16_t *a, uint32_t m, const uint16_t *b, uint32_t n, uint16_t *dest)
+{
+    uint32_t count = 0;
+    for (uint32_t i = 0, j = 0; i < m && j < n;)
     {
-        for (int j = 0; j < set2->count; j++)
-        {
-            if (!strcmp(rel->pair[i].elements[1], set2->elements[j]))
-            {
-                break;
-            }
-            if ((set2->count - 1) == j)
-            {
-                printf(_FALSE);
-                FreeRelation(rel);
-                FreeSet(set1);
-                FreeSet(set2);
-                return EXIT_SUCCESS;
-            }
-        }
+        if (a[i] == b[j])
+            dest[count++] = a[i];
+        uint16_t first = a[i];
+        i += first <= b[j];
+        j += b[j] <= first;
     }
-    // jeden vzor nema vice nez jeden obraz
-    for (int i = 0; i < rel->count; i++)
+    return count;
+}
+
+#ifdef SIMD_X86
+
+// SSE2 kernels (2 words at once, the rest is done by scalar kernels)
+
+__attribute__((target("sse2"))) void Sse2Or(uint64_t *dest, const uint64_t *a, const uint64_t *b, size_t words)
+{
+    size_t i = 0;
+    for (; i + 2 <= words; i += 2)
+        _mm_storeu_si128((__m128i *)(dest + i), _mm_or_si128(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i))));
+    ScalarOr(dest + i, a + i, b + i, words - i);
+}
+
+__attribute__((target("sse2"))) void Sse2And(uint64_t *dest, const uint64_t *a, const uint64_t *b, size_t words)
+{
+    size_t i = 0;
+    for (; i + 2 <= words; i += 2)
+        _mm_storeu_si128((__m128i *)(dest + i), _mm_and_si128(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i))));
+    ScalarAnd(dest + i, a + i, b + i, words - i);
+}
+
+__attribute__((target("sse2"))) void Sse2Andnot(uint64_t *dest, const uint64_t *a, const uint64_t *b, size_t words)
+{
+    size_t i = 0;
+    for (; i + 2 <= words; i += 2) // _mm_andnot_si128 negates its first argument
+        _mm_storeu_si128((__m128i *)(dest + i), _mm_andnot_si128(_mm_loadu_si128((const __m128i *)(b + i)), _mm_loadu_si128((const __m128i *)(a + i))));
+    ScalarAndnot(dest + i, a + i, b + i, words - i);
+}
+
+__attribute__((target("sse2"))) bool Sse2Zero(const uint64_t *a, size_t words)
+{
+    size_t i = 0;
+    for (; i + 2 <= words; i += 2)
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)), _mm_setzero_si128())) != 0xFFFF)
+            return false;
+    return ScalarZero(a + i, words - i);
+}
+
+__attribute__((target("sse2"))) bool Sse2Subseteq(const uint64_t *a, const uint64_t *b, size_t words)
+{
+    size_t i = 0;
+    for (; i + 2 <= words; i += 2)
     {
-        for (int j = 0; j < rel->count; j++)
-        {
-            if (!strcmp(rel->pair[i].elements[0], rel->pair[j].elements[0])) // same first elements
-            {
-                if (strcmp(rel->pair[i].elements[1], rel->pair[j].elements[1])) // different second element - we found a pair with same first element and different second element - not injective relation
-                {
-                    printf(_FALSE);
-                    FreeRelation(rel);
-                    FreeSet(set1);
-                    FreeSet(set2);
-                    return EXIT_SUCCESS;
-                }
-            }
-        }
+        __m128i rest = _mm_andnot_si128(_mm_loadu_si128((const __m128i *)(b + i)), _mm_loadu_si128((const __m128i *)(a + i)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(rest, _mm_setzero_si128())) != 0xFFFF)
+            return false;
     }
+    return ScalarSubseteq(a + i, b + i, words - i);
+}
 
-    printf(_TRUE);
-    FreeRelation(rel);
-    FreeSet(set1);
-    FreeSet(set2);
-    return EXIT_SUCCESS;
+__attribute__((target("sse2"))) bool Sse2Equal(const uint64_t *a, const uint64_t *b, size_t words)
+{
+    size_t i = 0;
+    for (; i + 2 <= words; i += 2)
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i)))) != 0xFFFF)
+            return false;
+    return ScalarEqual(a + i, b + i, words - i);
 }
 
-/*
- *  returns true if relation is Surjective
- *
- */
-int Surjective(rel_t *rel, set_t *set1, set_t *set2)
+// intersects blocks of 8 values: every value of block of a is compared with all the rotations of block of b, block with smaller
+// last value moves on (both move on if last values are equal), the rest is merged by scalar kernel. AVX2 uses it too, because
+// rotations of 16 values of 256-bit vector need shuffles across its halves
+__attribute__((target("sse2"))) uint32_t Sse2Intersect(const uint16_t *a, uint32_t m, const uint16_t *b, uint32_t n, uint16_t *dest)
 {
-    // we solve problem with having empty set but rel with elements
-    if (rel->count != 0)
+    uint32_t count = 0, i = 0, j = 0;
+
+    while (i + 8 <= m && j + 8 <= n)
     {
-        if (set1->count == 0)
-        {
-            printf(_FALSE);
-            FreeRelation(rel);
-            FreeSet(set1);
-            FreeSet(set2);
-            return EXIT_SUCCESS;
-        }
-        if (set2->count == 0)
+        __m128i block = _mm_loadu_si128((const __m128i *)(a + i)), rotated = _mm_loadu_si128((const __m128i *)(b + j));
+        __m128i found = _mm_cmpeq_epi16(block, rotated);
+        for (int k = 1; k < 8; k++)
         {
-            printf(_FALSE);
-            FreeRelation(rel);
-            FreeSet(set1);
-            FreeSet(set2);
-            return EXIT_SUCCESS;
+            rotated = _mm_or_si128(_mm_srli_si128(rotated, 2), _mm_slli_si128(rotated, 14));
+            found = _mm_or_si128(found, _mm_cmpeq_epi16(block, rotated));
         }
+        for (uint64_t mask = _mm_movemask_epi8(found) & 0x5555; mask; mask &= mask - 1) // the lower bit of every 16-bit lane
+            dest[count++] = a[i + Ctz64(mask) / 2];
+
+        uint16_t last = a[i + 7];
+        i += last <= b[j + 7] ? 8 : 0;
+        j += b[j + 7] <= last ? 8 : 0;
     }
+    return count + ScalarIntersect(a + i, m - i, b + j, n - j, dest + count);
+}
 
-    // all the first elements in rel are from set1
-    for (int i = 0; i < rel->count; i++)
-    {
-        for (int j = 0; j < set1->count; j++)
-        {
-            if (!strcmp(rel->pair[i].elements[0], set1->elements[j]))
-                break;
+// AVX2 kernels (4 words at once, the rest is done by scalar kernels)
 
-            if ((set1->count - 1) == j)
-            {
-                printf(_FALSE);
-                FreeRelation(rel);
-                FreeSet(set1);
-                FreeSet(set2);
-                return EXIT_SUCCESS;
-            }
-        }
-    }
+__attribute__((target("avx2"))) void Avx2Or(uint64_t *dest, const uint64_t *a, const uint64_t *b, size_t words)
+{
+    size_t i = 0;
+    for (; i + 4 <= words; i += 4)
+        _mm256_storeu_si256((__m256i *)(dest + i), _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i))));
+    ScalarOr(dest + i, a + i, b + i, words - i);
+}
 
-    // all the second elements in rel are from set2
-    for (int i = 0; i < rel->count; i++)
-    {
-        for (int j = 0; j < set2->count; j++)
-        {
-            if (!strcmp(rel->pair[i].elements[1], set2->elements[j]))
-                break;
+__attribute__((target("avx2"))) void Avx2And(uint64_t *dest, const uint64_t *a, const uint64_t *b, size_t words)
+{
+    size_t i = 0;
+    for (; i + 4 <= words; i += 4)
+        _mm256_storeu_si256((__m256i *)(dest + i), _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i))));
+    ScalarAnd(dest + i, a + i, b + i, words - i);
+}
 
-            if ((set2->count - 1) == j)
-            {
-                printf(_FALSE);
-                FreeRelation(rel);
-                FreeSet(set1);
-                FreeSet(set2);
-                return EXIT_SUCCESS;
-            }
-        }
-    }
-    // checks if every codomain is being assigned
-    // and so we wont forget any Y
-    for (int i = 0; i < set2->count; i++)
-    {
-        for (int j = 0; j < rel->count; j++)
-        {
-            if (!strcmp(set2->elements[i], rel->pair[j].elements[1]))
-                break;
+__attribute__((target("avx2"))) void Avx2Andnot(uint64_t *dest, const uint64_t *a, const uint64_t *b, size_t words)
+{
+    size_t i = 0;
+    for (; i + 4 <= words; i += 4) // _mm256_andnot_si256 negates its first argument
+        _mm256_storeu_si256((__m256i *)(dest + i), _mm256_andnot_si256(_mm256_loadu_si256((const __m256i *)(b + i)), _mm256_loadu_si256((const __m256i *)(a + i))));
+    ScalarAndnot(dest + i, a + i, b + i, words - i);
+}
 
-            if ((rel->count - 1) == j)
-            {
-                printf(_FALSE);
-                FreeRelation(rel);
-                FreeSet(set1);
-                FreeSet(set2);
-                return EXIT_SUCCESS;
-            }
-        }
+// popcount of 4 words at once by lookup table of nibbles (Mula's algorithm)
+__attribute__((target("avx2"))) size_t Avx2Popcount(const uint64_t *a, size_t words)
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0F);
+    __m256i total = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 4 <= words; i += 4)
+    {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(block, low)),
+                                         _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(block, 4), low)));
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(counts, _mm256_setzero_si256())); // sums bytes into 4 words
     }
-    // checks if in every pair the first element exists
-    // and is being assigned to Y
-    for (int i = 0; i < rel->count; i++)
-        if (rel->pair[i].elements[0] == NULL)
-        {
-            printf(_FALSE);
-            FreeRelation(rel);
-            FreeSet(set1);
-            FreeSet(set2);
-            return EXIT_SUCCESS;
-        }
 
-    printf(_TRUE);
-    FreeRelation(rel);
-    FreeSet(set1);
-    FreeSet(set2);
-    return EXIT_SUCCESS;
+    uint64_t sums[4];
+    _mm256_storeu_si256((__m256i *)sums, total);
+    return sums[0] + sums[1] + sums[2] + sums[3] + ScalarPopcount(a + i, words - i);
 }
 
-/*
- *  returns true if relation is Bijective
- *
- */
-int Bijective(rel_t *rel, set_t *set1, set_t *set2)
+__attribute__((target("avx2"))) bool Avx2Zero(const uint64_t *a, size_t words)
 {
-    if (rel->count != set1->count || rel->count != set2->count) // has to have same count
+    size_t i = 0;
+    for (; i + 4 <= words; i += 4)
     {
-        printf(_FALSE);
-        return EXIT_SUCCESS;
+        __m256i block = _mm256_loadu_si256((const __m256i *)(a + i));
+        if (!_mm256_testz_si256(block, block))
+            return false;
     }
+    return ScalarZero(a + i, words - i);
+}
 
-    // all the first elements in rel are from set1
-    for (int i = 0; i < rel->count; i++)
+__attribute__((target("avx2"))) bool Avx2Subseteq(const uint64_t *a, const uint64_t *b, size_t words)
+{
+    size_t i = 0;
+    for (; i + 4 <= words; i += 4) // testc is true when (a & ~b) == 0
+        if (!_mm256_testc_si256(_mm256_loadu_si256((const __m256i *)(b + i)), _mm256_loadu_si256((const __m256i *)(a + i))))
+            return false;
+    return ScalarSubseteq(a + i, b + i, words - i);
+}
+
+__attribute__((target("avx2"))) bool Avx2Equal(const uint64_t *a, const uint64_t *b, size_t words)
+{
+    size_t i = 0;
+    for (; i + 4 <= words; i += 4)
     {
-        for (int j = 0; j < set1->count; j++)
-        {
-            if (!strcmp(rel->pair[i].elements[0], set1->elements[j]))
-                break;
-            if ((rel->count - 1) == j)
-            {
-                printf(_FALSE);
-                return EXIT_SUCCESS;
-            }
-        }
+        __m256i diff = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i)));
+        if (!_mm256_testz_si256(diff, diff))
+            return false;
     }
+    return ScalarEqual(a + i, b + i, words - i);
+}
 
-    // all the second elements in rel are from set2
-    for (int i = 0; i < rel->count; i++)
+#endif
+
+// selects bitset kernels by CPU features
+void InitKernels(void)
+{
+    kernels_t scalar = {ScalarOr, ScalarAnd, ScalarAndnot, ScalarPopcount, ScalarZero, ScalarSubseteq, ScalarEqual, ScalarIntersect};
+    kernels = scalar;
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
     {
-        for (int j = 0; j < set2->count; j++)
-        {
-            if (!strcmp(rel->pair[i].elements[1], set2->elements[j]))
-                break;
-            if ((rel->count - 1) == j)
-            {
-                printf(_FALSE);
-                return EXIT_SUCCESS;
-            }
-        }
+        kernels_t avx2 = {Avx2Or, Avx2And, Avx2Andnot, Avx2Popcount, Avx2Zero, Avx2Subseteq, Avx2Equal, Sse2Intersect};
+        kernels = avx2;
     }
-
-    // all first or second elements are not repeating
-    for (int i = 0; i < rel->count - 1; i++)
+    else if (__builtin_cpu_supports("sse2"))
     {
-        for (int j = i + 1; j < rel->count; j++)
-        {
-            if ((!strcmp(rel->pair[i].elements[0], rel->pair[j].elements[0])) || (!strcmp(rel->pair[i].elements[1], rel->pair[j].elements[1])))
-            {
-                printf(_FALSE);
-                return EXIT_SUCCESS;
-            }
-        }
+        kernels_t sse2 = {Sse2Or, Sse2And, Sse2Andnot, ScalarPopcount, Sse2Zero, Sse2Subseteq, Sse2Equal, Sse2Intersect};
+        kernels = sse2;
     }
-
-    FreeRelation(rel);
-    FreeSet(set1);
-    FreeSet(set2);
-    printf(_TRUE);
-    return EXIT_SUCCESS;
+#endif
 }
 
-// returns true if array of strings has 2 same strings
-bool EqualStrings(string *strs, int size)
+// transposes 64x64 bit matrix in place (bit j of word i becomes bit i of word j), swaps smaller and smaller blocks
+void Transpose64(uint64_t *block)
 {
-    for (int i = 0; i < size; i++)
-        for (int j = i + 1; j < size; j++)
-            if (!strcmp(strs[i], strs[j]))
-                return true;
-    return false;
+    uint64_t mask = 0x00000000FFFFFFFFull; // lower halves of blocks
+    for (int size = 32; size; size >>= 1, mask ^= mask << size)
+        for (int i = 0; i < WORD_BITS; i = (i + size + 1) & ~size)
+        {
+            uint64_t swap = ((block[i] >> size) ^ block[i + size]) & mask;
+            block[i] ^= swap << size;
+            block[i + size] ^= swap;
+        }
 }
 
-// returns true string is a restricted word
-bool isRestricted(string str)
+// prints element of set with space before it (lengths of names are already known)
+void __print_element(output_t *out, symtab_t *universum, uint32_t id)
 {
-    bool found = false;
-    for (int i = 0; i < RESTRICTED_COUNT; i++)
-        if ((found = !strcmp(RESTRICTED[i], str)))
-            break;
-
-    return found;
+    OutputChar(out, ' ');
+    OutputWrite(out, ElementName(universum, id), universum->lengths[id]);
 }
 
-// returns true if string is a universum element
-bool isUniversumElement(string str, set_t *universum)
+// prints set (or other type of line) with names of elements, containers are in the order of IDs
+void PrintSet(output_t *out, symtab_t *universum, const set_t *set, char type)
 {
-    bool found = false;
-    for (int z = 0; z < universum->count; z++)
-        if ((found = !strcmp(str, universum->elements[z])))
-            break;
-
-    return found;
-}
\ No newline at end of file
+    OutputChar(out, type);
+    for (uint32_t i = 0; i < set->size; i++)
+    {
+        const container_t *container = &set->containers[i];
+        const uint64_t *data = set->data + container->offset;
+        const uint16_t *values = (const uint16_t *)data;
+        uint32_t base = container->key << CHUNK_BITS;
+
+        if (container->type == ARRAY_CONTAINER)
+            for (uint32_t k = 0; k < container->size; k++)
+                __print_element(out, universum, base + values[k]);
+        else if (container->type == RUN_CONTAINER)
+            for (uint32_t k = 0; k < container->size; k++)
+                for (uint32_t id = base + values[2 * k], end = id + values[2 * k + 1]; id <= end; id++)
+                    __print_element(out, universum, id);
+        else
+            for (size_t w = 0; w < CHUNK_WORDS; w++)
+                for (uint64_t word = data[w]; word; word &= word - 1) // goes through all the bits set in word
+                    __print_element(out, universum, base + w * WORD_BITS + Ctz64(word));
+    }
+}